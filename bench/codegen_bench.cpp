@@ -0,0 +1,312 @@
+#include "compress_weights.hpp"
+#include "compute_graph.hpp"
+#include "cost_manifest.hpp"
+#include "denox_create_nodes.hpp"
+#include "denox_query_cost.hpp"
+#include "denox_read_source.hpp"
+#include "denox_roi.hpp"
+#include "dnx_file.hpp"
+#include "io.hpp"
+#include "shader_registry.hpp"
+#include "source_writer.hpp"
+#include "symbolics.hpp"
+#include "synthetic_dnx.hpp"
+#include <CLI/CLI.hpp>
+#include <algorithm>
+#include <chrono>
+#include <dnx.h>
+#include <exception>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Corpus of the default benchmark, from small to large.
+std::vector<vkdt_denox::SyntheticModel> default_corpus() {
+  return {
+      {.name = "chain-64", .dispatches = 64},
+      {.name = "chain-1k", .dispatches = 1024, .shaders = 64},
+      {.name = "branch-512", .dispatches = 513, .branches = 8},
+      {.name = "concat-512",
+       .dispatches = 513,
+       .branches = 8,
+       .concat_every = 4},
+      {.name = "deep-symbolic-256", .dispatches = 256, .symbolic_depth = 24},
+      {.name = "large-weights",
+       .dispatches = 64,
+       .weight_bytes = uint64_t(256) << 20},
+  };
+}
+
+struct Stage {
+  std::string name;
+  double ms = std::numeric_limits<double>::infinity();
+};
+
+struct ModelResult {
+  std::string name;
+  uint32_t dispatches = 0;
+  uint32_t shaders = 0;
+  uint64_t weight_bytes = 0;
+  uint32_t symbols = 0;
+  std::vector<Stage> stages;
+  double total_ms = 0;
+  // Peak resident set size of the last repetition, if the peak of the process
+  // can be reset between models.
+  std::optional<uint64_t> peak_rss_kib;
+};
+
+/// Resets the peak resident set size of the process, returns false if the
+/// kernel does not support it.
+bool reset_peak_rss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+  return static_cast<bool>(clear_refs.flush());
+}
+
+/// Peak resident set size since the last reset_peak_rss.
+std::optional<uint64_t> peak_rss_kib() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("VmHWM:")) {
+      return std::stoull(line.substr(6));
+    }
+  }
+  return std::nullopt;
+}
+
+/// Peak resident set size of the whole run, which cannot be reset.
+uint64_t process_peak_rss_kib() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<uint64_t>(usage.ru_maxrss);
+}
+
+/// Times the stages of the codegen of a single module, in the order of
+/// vkdt-denox. The minimum of all repetitions is reported per stage.
+class StageTimer {
+public:
+  explicit StageTimer(std::vector<Stage> &stages) : m_stages(stages) {}
+
+  template <typename F> auto operator()(const char *name, F &&fn) {
+    const auto begin = std::chrono::steady_clock::now();
+    auto result = fn();
+    const auto end = std::chrono::steady_clock::now();
+    record(name,
+           std::chrono::duration<double, std::milli>(end - begin).count());
+    return result;
+  }
+
+private:
+  void record(const char *name, double ms) {
+    if (m_index == m_stages.size()) {
+      m_stages.push_back(Stage{.name = name});
+    }
+    Stage &stage = m_stages[m_index++];
+    stage.ms = std::min(stage.ms, ms);
+  }
+
+  std::vector<Stage> &m_stages;
+  std::size_t m_index = 0;
+};
+
+ModelResult run_model(const fs::path &dnx_path, const fs::path &output_dir,
+                      uint32_t repeat) {
+  ModelResult result;
+  result.name = dnx_path.stem().string();
+  const std::string module_name = "bench";
+
+  for (uint32_t r = 0; r < repeat; ++r) {
+    // Without a reset, the peak includes the ones of the previous models.
+    const bool peak_reset = reset_peak_rss();
+    StageTimer time(result.stages);
+
+    const vkdt_denox::DnxFile dnx_file = time(
+        "load", [&] { return vkdt_denox::read_dnx_file(dnx_path); });
+    const denox::dnx::Model *dnx = dnx_file.model;
+    const vkdt_denox::SymbolicIR symbolic_ir = time(
+        "symbolic_ir", [&] { return vkdt_denox::read_symbolic_ir(dnx); });
+    const vkdt_denox::ShaderRegistry shader_registry =
+        time("shader_registry",
+             [&] { return vkdt_denox::create_shader_registry(dnx); });
+    const vkdt_denox::CompressedWeights compressed_weights = time(
+        "compress_weights", [&] { return vkdt_denox::compress_weights(dnx); });
+    const vkdt_denox::ComputeGraph compute_graph =
+        time("compute_graph", [&] {
+          return vkdt_denox::reconstruct_compute_graph(dnx, compressed_weights,
+                                                       shader_registry);
+        });
+
+    vkdt_denox::SourceWriter src;
+    src.add_header_guard("BENCH_DENOX_MODULE_H");
+    time("read_source", [&] {
+      vkdt_denox::def_func_denox_read_source(src, compute_graph,
+                                             compressed_weights,
+                                             "bench.dat", module_name);
+      return 0;
+    });
+    time("create_nodes", [&] {
+      vkdt_denox::def_struct_denox_cost(src);
+      vkdt_denox::def_func_denox_create_nodes(src, dnx, symbolic_ir,
+                                              shader_registry,
+                                              compressed_weights,
+                                              compute_graph, module_name);
+      return 0;
+    });
+    time("query_cost", [&] {
+      vkdt_denox::def_func_denox_query_cost(src, symbolic_ir, compute_graph,
+                                            compressed_weights);
+      return 0;
+    });
+    time("roi", [&] {
+      vkdt_denox::def_func_denox_roi(src, dnx, symbolic_ir);
+      return 0;
+    });
+    const std::string source =
+        time("source_finish", [&] { return src.finish(); });
+    const std::string cost_manifest = time("cost_manifest", [&] {
+      return vkdt_denox::create_cost_manifest(symbolic_ir, compute_graph,
+                                              shader_registry, module_name);
+    });
+    time("write", [&] {
+      vkdt_denox::write_file(output_dir / "denox_model.h", source);
+      vkdt_denox::write_file(output_dir / "denox_model.json", cost_manifest);
+      vkdt_denox::write_file_chunks(output_dir / "bench.dat",
+                                    compressed_weights.chunks);
+      return 0;
+    });
+
+    result.peak_rss_kib =
+        peak_reset ? peak_rss_kib() : std::optional<uint64_t>{};
+    result.dispatches = dnx->dispatches()->size();
+    result.shaders = shader_registry.binaries.size();
+    result.weight_bytes = compressed_weights.byte_size;
+    result.symbols = symbolic_ir.vars.size() +
+                     (dnx->sym_ir()->ops() == nullptr
+                          ? 0
+                          : dnx->sym_ir()->ops()->size());
+  }
+  result.total_ms = 0;
+  for (const Stage &stage : result.stages) {
+    result.total_ms += stage.ms;
+  }
+  return result;
+}
+
+std::string optional_value(const std::optional<uint64_t> &value,
+                           std::string_view none) {
+  return value.has_value() ? fmt::format("{}", *value) : std::string(none);
+}
+
+std::string create_report(const std::vector<ModelResult> &results) {
+  using vkdt_denox::json_string;
+  std::string json = fmt::format("{{\n  \"peak_rss_kib\": {},\n  \"models\": [",
+                                 process_peak_rss_kib());
+  for (std::size_t m = 0; m < results.size(); ++m) {
+    const ModelResult &result = results[m];
+    json.append(m == 0 ? "\n" : ",\n");
+    json.append(fmt::format(
+        "    {{\"name\": {}, \"dispatches\": {}, \"shaders\": {}, "
+        "\"weight_bytes\": {}, \"symbols\": {}, \"stages\": {{",
+        json_string(result.name), result.dispatches, result.shaders,
+        result.weight_bytes, result.symbols));
+    for (std::size_t s = 0; s < result.stages.size(); ++s) {
+      json.append(fmt::format("{}{}: {:.3f}", s == 0 ? "" : ", ",
+                              json_string(result.stages[s].name),
+                              result.stages[s].ms));
+    }
+    json.append(fmt::format("}}, \"total_ms\": {:.3f}, \"peak_rss_kib\": {}}}",
+                            result.total_ms,
+                            optional_value(result.peak_rss_kib, "null")));
+  }
+  json.append("\n  ]\n}\n");
+  return json;
+}
+
+void print_results(const std::vector<ModelResult> &results) {
+  for (const ModelResult &result : results) {
+    fmt::println("{}: {} dispatches, {} shaders, {} weight bytes, {} symbols",
+                 result.name, result.dispatches, result.shaders,
+                 result.weight_bytes, result.symbols);
+    for (const Stage &stage : result.stages) {
+      fmt::println("  {:<18} {:>10.3f} ms", stage.name, stage.ms);
+    }
+    fmt::println("  {:<18} {:>10.3f} ms", "total", result.total_ms);
+    fmt::println("  {:<18} {:>10} KiB", "peak rss",
+                 optional_value(result.peak_rss_kib, "-"));
+  }
+  fmt::println("peak rss of the run: {} KiB", process_peak_rss_kib());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  CLI::App app{"vkdt-denox-bench — times the codegen stages of vkdt-denox"};
+
+  std::vector<std::string> dnx_paths;
+  std::string json_path;
+  std::string work_dir_str;
+  uint32_t repeat = 3;
+
+  app.add_option("dnx", dnx_paths,
+                 "Artifacts (.dnx) to benchmark. Without artifacts, a corpus "
+                 "of synthetic models is generated")
+      ->check(CLI::ExistingFile);
+  app.add_option("--json", json_path,
+                 "Writes the results as JSON, e.g. for tracking them in CI");
+  app.add_option("--repeat", repeat,
+                 "Repetitions per model, the fastest one is reported "
+                 "(default: 3)")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--work-dir", work_dir_str,
+                 "Directory for the generated corpus and outputs (default: a "
+                 "temporary directory)");
+
+  CLI11_PARSE(app, argc, argv);
+
+  try {
+    const fs::path work_dir =
+        work_dir_str.empty()
+            ? fs::temp_directory_path() /
+                  fmt::format("vkdt-denox-bench-{}", getpid())
+            : fs::path(work_dir_str);
+    fs::create_directories(work_dir / "out");
+
+    if (dnx_paths.empty()) {
+      for (const auto &model : default_corpus()) {
+        const fs::path path = work_dir / (model.name + ".dnx");
+        const std::vector<uint8_t> dnx =
+            vkdt_denox::generate_synthetic_dnx(model);
+        vkdt_denox::write_file_bytes(path, dnx.data(), dnx.size());
+        dnx_paths.push_back(path.string());
+      }
+    }
+
+    std::vector<ModelResult> results;
+    for (const auto &dnx_path : dnx_paths) {
+      results.push_back(run_model(dnx_path, work_dir / "out", repeat));
+    }
+    print_results(results);
+    if (!json_path.empty()) {
+      vkdt_denox::write_file(json_path, create_report(results));
+    }
+    if (work_dir_str.empty()) {
+      fs::remove_all(work_dir);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "io.hpp"
+#include "synthetic_dnx.hpp"
+#include <CLI/CLI.hpp>
+#include <exception>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+  CLI::App app{"vkdt-denox-dnxgen — writes synthetic .dnx artifacts for "
+               "benchmarking the codegen"};
+
+  vkdt_denox::SyntheticModel model;
+  std::string output_path;
+
+  app.add_option("output", output_path, "Output artifact (.dnx)")
+      ->required();
+  app.add_option("--name", model.name, "Model version string of the artifact");
+  app.add_option("--dispatches", model.dispatches,
+                 "Total number of compute dispatches (default: 64)")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--branches", model.branches,
+                 "Number of parallel chains, which are joined by a final "
+                 "dispatch (default: 1)")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--concat-every", model.concat_every,
+                 "Concatenate the branches in memory every n-th layer "
+                 "(default: 0, never)");
+  app.add_option("--symbolic-depth", model.symbolic_depth,
+                 "Number of symbolic ops per extent expression (default: 3)");
+  app.add_option("--weight-bytes", model.weight_bytes,
+                 "Total size of all weights in bytes (default: 1MiB)");
+  app.add_option("--shaders", model.shaders,
+                 "Number of distinct shader binaries (default: 16)")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--channels", model.channels,
+                 "Channels of every tensor (default: 16)")
+      ->check(CLI::PositiveNumber);
+
+  CLI11_PARSE(app, argc, argv);
+
+  try {
+    const std::vector<uint8_t> dnx = vkdt_denox::generate_synthetic_dnx(model);
+    vkdt_denox::write_file_bytes(output_path, dnx.data(), dnx.size());
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
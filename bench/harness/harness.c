@@ -0,0 +1,151 @@
+// Compiles the generated denox_model.h against the stand-in api of
+// modules/api.h and reports the graph denox_create_nodes creates for a range
+// of resolutions. Invalid calls (unknown nodes or connectors, mismatching or
+// unconnected inputs) fail the harness.
+
+#include "denox_model.h"
+#include "harness_config.h"
+#include "modules/api.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The parameters of denox_create_nodes depend on the model: its named
+// extents, followed by the id and connector name of every input and output.
+// The default matches the synthetic models of vkdt-denox-dnxgen, other models
+// configure it with VKDT_DENOX_HARNESS_CREATE_NODES.
+#ifndef DENOX_HARNESS_CREATE_NODES
+#define DENOX_HARNESS_CREATE_NODES(graph, module, wd, ht)                      \
+  denox_create_nodes(graph, module, ht, wd, 0, NULL, 1, NULL)
+#endif
+
+static double now_ms(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec * 1e-6;
+}
+
+static uint64_t connector_bytes(const dt_connector_t *connector) {
+  const uint64_t channels = connector->chan == dt_token("rgba") ? 4 : 1;
+  uint64_t format_size = 4;
+  if (connector->format == dt_token("f16")) {
+    format_size = 2;
+  } else if (connector->format == dt_token("u8")) {
+    format_size = 1;
+  }
+  return (uint64_t)connector->roi.wd * connector->roi.ht * channels *
+         format_size;
+}
+
+typedef struct graph_stats_t {
+  int nodes;
+  int connections;
+  int copies;
+  // Bytes of all buffers written by the nodes (write and source connectors).
+  uint64_t roi_bytes;
+} graph_stats_t;
+
+static graph_stats_t graph_stats(dt_graph_t *graph) {
+  graph_stats_t stats = {
+      .nodes = graph->num_nodes,
+      .connections = graph->num_connections,
+      .copies = graph->num_copies,
+      .roi_bytes = 0,
+  };
+  for (int n = 0; n < graph->num_nodes; ++n) {
+    const dt_node_t *node = graph->node + n;
+    for (int c = 0; c < node->num_connectors; ++c) {
+      const dt_connector_t *connector = node->connector + c;
+      if (connector->type != dt_token("read")) {
+        stats.roi_bytes += connector_bytes(connector);
+      } else if (connector->connected_mi == -1 && !connector->copied) {
+        // Reported like the errors of the api calls.
+        ++graph->num_errors;
+        if (graph->num_errors == 1) {
+          snprintf(graph->gui_msg_buf, sizeof(graph->gui_msg_buf),
+                   "input %d:%d is not connected", n, c);
+        }
+      }
+    }
+  }
+  return stats;
+}
+
+#ifdef DENOX_ROI_HELPERS
+static uint32_t align_up(uint32_t value, uint32_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+#endif
+
+int main(int argc, char **argv) {
+  static const uint32_t default_resolutions[][2] = {
+      {256, 256}, {640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160},
+  };
+  int repeat = 10;
+  uint32_t resolutions[64][2];
+  int resolution_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    unsigned wd, ht;
+    if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (sscanf(argv[i], "%ux%u", &wd, &ht) == 2 && wd != 0 &&
+               ht != 0 && resolution_count < 64) {
+      resolutions[resolution_count][0] = wd;
+      resolutions[resolution_count][1] = ht;
+      ++resolution_count;
+    } else {
+      fprintf(stderr, "usage: %s [--repeat <n>] [<wd>x<ht>...]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (resolution_count == 0) {
+    resolution_count =
+        sizeof(default_resolutions) / sizeof(default_resolutions[0]);
+    memcpy(resolutions, default_resolutions, sizeof(default_resolutions));
+  }
+  if (repeat < 1) {
+    repeat = 1;
+  }
+
+  dt_graph_t graph = {0};
+  dt_module_t module = {.graph = &graph, .name = dt_token("denox")};
+  int failed = 0;
+  printf("%11s %7s %11s %7s %14s %12s\n", "resolution", "nodes",
+         "connections", "copies", "roi bytes", "create ms");
+  for (int r = 0; r < resolution_count; ++r) {
+    // Extents, which are not multiples of the alignment of the model, are
+    // not exactly proportional, see denox_roi_align_wd. Models without ROI
+    // helpers run at the given extents.
+#ifdef DENOX_ROI_HELPERS
+    const uint32_t wd = align_up(resolutions[r][0], denox_roi_align_wd);
+    const uint32_t ht = align_up(resolutions[r][1], denox_roi_align_ht);
+#else
+    const uint32_t wd = resolutions[r][0];
+    const uint32_t ht = resolutions[r][1];
+#endif
+    double best_ms = 0;
+    for (int i = 0; i < repeat; ++i) {
+      dt_graph_reset(&graph);
+      const double begin = now_ms();
+      DENOX_HARNESS_CREATE_NODES(&graph, &module, wd, ht);
+      const double ms = now_ms() - begin;
+      if (i == 0 || ms < best_ms) {
+        best_ms = ms;
+      }
+    }
+    const graph_stats_t stats = graph_stats(&graph);
+    char resolution[32];
+    snprintf(resolution, sizeof(resolution), "%ux%u", wd, ht);
+    printf("%11s %7d %11d %7d %14llu %12.4f\n", resolution, stats.nodes,
+           stats.connections, stats.copies,
+           (unsigned long long)stats.roi_bytes, best_ms);
+    if (graph.num_errors != 0) {
+      fprintf(stderr, "%s: %d invalid calls, first: %s\n", resolution,
+              graph.num_errors, graph.gui_msg_buf);
+      failed = 1;
+    }
+  }
+  dt_graph_cleanup(&graph);
+  return failed;
+}
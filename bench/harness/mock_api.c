@@ -0,0 +1,171 @@
+#include "modules/api.h"
+#include <stdarg.h>
+#include <stdlib.h>
+
+// Counts an invalid call, the first one is described in gui_msg_buf.
+static void graph_error(dt_graph_t *graph, const char *format, ...) {
+  if (graph->num_errors++ != 0) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  vsnprintf(graph->gui_msg_buf, sizeof(graph->gui_msg_buf), format, args);
+  va_end(args);
+}
+
+static int find_connector(const dt_node_t *node, const char *name) {
+  const dt_token_t token = dt_token(name);
+  for (int c = 0; c < node->num_connectors; ++c) {
+    if (node->connector[c].name == token) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+static int is_type(const dt_connector_t *connector, const char *type) {
+  return connector->type == dt_token(type);
+}
+
+int dt_node_add(dt_graph_t *graph, dt_module_t *module, const char *name,
+                const char *kernel, int wd, int ht, int dp, int pc_len,
+                const int *push, int num_connectors, ...) {
+  (void)module;
+  (void)push;
+  if (num_connectors < 0 || num_connectors > DT_MAX_CONNECTORS) {
+    graph_error(graph, "%s: %d connectors exceed the limit of %d", name,
+                num_connectors, DT_MAX_CONNECTORS);
+    return -1;
+  }
+  if (graph->num_nodes == graph->max_nodes) {
+    graph->max_nodes = graph->max_nodes == 0 ? 256 : 2 * graph->max_nodes;
+    graph->node =
+        realloc(graph->node, sizeof(dt_node_t) * (size_t)graph->max_nodes);
+    if (graph->node == NULL) {
+      abort();
+    }
+  }
+  const int id = graph->num_nodes++;
+  dt_node_t *node = graph->node + id;
+  memset(node, 0, sizeof(*node));
+  node->name = dt_token(name);
+  node->kernel = dt_token(kernel);
+  node->wd = (uint32_t)wd;
+  node->ht = (uint32_t)ht;
+  node->dp = (uint32_t)dp;
+  node->push_constant_size = pc_len;
+  node->num_connectors = num_connectors;
+  if (wd <= 0 || ht <= 0 || dp <= 0) {
+    graph_error(graph, "%s (%s): empty dispatch %dx%dx%d", name, kernel, wd,
+                ht, dp);
+  }
+
+  va_list args;
+  va_start(args, num_connectors);
+  for (int c = 0; c < num_connectors; ++c) {
+    dt_connector_t *connector = node->connector + c;
+    const char *connector_name = va_arg(args, const char *);
+    connector->name = dt_token(connector_name);
+    connector->type = dt_token(va_arg(args, const char *));
+    connector->chan = dt_token(va_arg(args, const char *));
+    connector->format = dt_token(va_arg(args, const char *));
+    const dt_roi_t *roi = va_arg(args, const dt_roi_t *);
+    if (roi != NULL) {
+      connector->roi = *roi;
+    }
+    connector->connected_mi = -1;
+    connector->connected_mc = -1;
+    if (!is_type(connector, "read") && !is_type(connector, "write") &&
+        !is_type(connector, "source")) {
+      graph_error(graph, "%s (%s): connector %s has an unknown type", name,
+                  kernel, connector_name);
+    }
+    if (!is_type(connector, "read") && roi == NULL) {
+      graph_error(graph, "%s (%s): output %s has no roi", name, kernel,
+                  connector_name);
+    }
+  }
+  va_end(args);
+  return id;
+}
+
+int dt_node_connect_named(dt_graph_t *graph, int m0, const char *c0, int m1,
+                          const char *c1) {
+  ++graph->num_connections;
+  if (m0 < 0 || m0 >= graph->num_nodes || m1 < 0 || m1 >= graph->num_nodes) {
+    graph_error(graph, "connection %d:%s -> %d:%s refers to an unknown node",
+                m0, c0, m1, c1);
+    return 1;
+  }
+  const int src = find_connector(graph->node + m0, c0);
+  const int dst = find_connector(graph->node + m1, c1);
+  if (src < 0 || dst < 0) {
+    graph_error(graph,
+                "connection %d:%s -> %d:%s refers to an unknown connector", m0,
+                c0, m1, c1);
+    return 1;
+  }
+  const dt_connector_t *output = graph->node[m0].connector + src;
+  dt_connector_t *input = graph->node[m1].connector + dst;
+  if (is_type(output, "read") || !is_type(input, "read")) {
+    graph_error(graph, "connection %d:%s -> %d:%s does not connect an output "
+                       "to an input",
+                m0, c0, m1, c1);
+    return 1;
+  }
+  if (input->connected_mi != -1 || input->copied) {
+    graph_error(graph, "input %d:%s is connected twice", m1, c1);
+    return 1;
+  }
+  if (output->chan != input->chan ||
+      (output->format != input->format && input->format != dt_token("*"))) {
+    graph_error(graph, "connection %d:%s -> %d:%s has mismatching formats", m0,
+                c0, m1, c1);
+    return 1;
+  }
+  input->connected_mi = m0;
+  input->connected_mc = src;
+  return 0;
+}
+
+void dt_connector_copy(dt_graph_t *graph, dt_module_t *module, int mc, int nid,
+                       int nc) {
+  (void)module;
+  ++graph->num_copies;
+  if (nid < 0 || nid >= graph->num_nodes || nc < 0 ||
+      nc >= graph->node[nid].num_connectors) {
+    graph_error(graph, "module connector %d is copied to unknown %d:%d", mc,
+                nid, nc);
+    return;
+  }
+  dt_connector_t *connector = graph->node[nid].connector + nc;
+  if (connector->copied) {
+    graph_error(graph, "module connector %d is copied to %d:%d twice", mc, nid,
+                nc);
+  }
+  connector->copied = 1;
+}
+
+FILE *dt_graph_open_resource(dt_graph_t *graph, int frame, const char *fname,
+                             const char *mode) {
+  (void)graph;
+  (void)frame;
+  (void)fname;
+  (void)mode;
+  return NULL;
+}
+
+void dt_graph_reset(dt_graph_t *graph) {
+  graph->num_nodes = 0;
+  graph->num_connections = 0;
+  graph->num_copies = 0;
+  graph->num_errors = 0;
+  graph->gui_msg_buf[0] = '\0';
+}
+
+void dt_graph_cleanup(dt_graph_t *graph) {
+  free(graph->node);
+  graph->node = NULL;
+  graph->max_nodes = 0;
+  dt_graph_reset(graph);
+}
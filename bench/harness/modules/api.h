@@ -0,0 +1,97 @@
+#pragma once
+
+// Minimal stand-in for vkdt's modules/api.h, which provides exactly the part
+// of the api the generated denox_model.h uses. The graph only records the
+// created nodes and connections (see mock_api.c), nothing is allocated on a
+// device.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DT_LOCAL_SIZE_X 32
+#define DT_LOCAL_SIZE_Y 32
+#define DT_MAX_CONNECTORS 30
+
+typedef uint64_t dt_token_t;
+
+// Names of up to 8 characters packed into an integer, as in vkdt.
+static inline dt_token_t dt_token(const char *str) {
+  dt_token_t token = 0;
+  size_t len = 0;
+  while (len < sizeof(token) && str[len] != '\0') {
+    ++len;
+  }
+  memcpy(&token, str, len);
+  return token;
+}
+
+typedef struct dt_roi_t {
+  uint32_t full_wd, full_ht;
+  uint32_t wd, ht;
+  float scale;
+} dt_roi_t;
+
+#define dt_no_roi ((const dt_roi_t *)0)
+
+typedef struct dt_connector_t {
+  dt_token_t name;
+  dt_token_t type;
+  dt_token_t chan;
+  dt_token_t format;
+  dt_roi_t roi;
+  uint64_t ssbo_offset;
+  // Node and connector of the source, -1 if not connected. Connections to
+  // module connectors (dt_connector_copy) have no source node.
+  int connected_mi;
+  int connected_mc;
+  int copied;
+} dt_connector_t;
+
+typedef struct dt_node_t {
+  dt_token_t name;
+  dt_token_t kernel;
+  uint32_t wd, ht, dp;
+  int push_constant_size;
+  int num_connectors;
+  dt_connector_t connector[DT_MAX_CONNECTORS];
+} dt_node_t;
+
+typedef struct dt_graph_t {
+  dt_node_t *node;
+  int num_nodes;
+  int max_nodes;
+  // Calls of dt_node_connect_named and dt_connector_copy.
+  int num_connections;
+  int num_copies;
+  // Number of invalid calls, the first one is described in gui_msg_buf.
+  int num_errors;
+  char gui_msg_buf[256];
+} dt_graph_t;
+
+typedef struct dt_module_t {
+  dt_graph_t *graph;
+  dt_token_t name;
+} dt_module_t;
+
+typedef struct dt_read_source_params_t {
+  dt_node_t *node;
+} dt_read_source_params_t;
+
+// Varargs are num_connectors times: name, type, chan, format and roi.
+int dt_node_add(dt_graph_t *graph, dt_module_t *module, const char *name,
+                const char *kernel, int wd, int ht, int dp, int pc_len,
+                const int *push, int num_connectors, ...);
+
+int dt_node_connect_named(dt_graph_t *graph, int m0, const char *c0, int m1,
+                          const char *c1);
+
+void dt_connector_copy(dt_graph_t *graph, dt_module_t *module, int mc, int nid,
+                       int nc);
+
+FILE *dt_graph_open_resource(dt_graph_t *graph, int frame, const char *fname,
+                             const char *mode);
+
+void dt_graph_reset(dt_graph_t *graph);
+
+void dt_graph_cleanup(dt_graph_t *graph);
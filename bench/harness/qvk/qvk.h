@@ -0,0 +1,10 @@
+#pragma once
+
+// Stand-in for vkdt's qvk/qvk.h, which the generated denox_model.h includes
+// for cooperative matrix variants.
+
+typedef struct qvk_t {
+  int coopmat_supported;
+} qvk_t;
+
+static qvk_t qvk = {.coopmat_supported = 1};
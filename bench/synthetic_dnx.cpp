@@ -0,0 +1,375 @@
+#include "synthetic_dnx.hpp"
+#include "spirv.hpp"
+#include <algorithm>
+#include <cstring>
+#include <dnx.h>
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace vkdt_denox {
+
+namespace {
+
+using denox::dnx::ScalarSource;
+using denox::dnx::SymIROpCode;
+
+/// Scalar source of a table field, either a literal or a symbol.
+struct Scalar {
+  ScalarSource type;
+  flatbuffers::Offset<void> value;
+};
+
+/// Tensor and the buffer, which stores it.
+struct LayerTensor {
+  uint32_t tensor;
+  uint32_t buffer;
+};
+
+class SyntheticModelBuilder {
+public:
+  explicit SyntheticModelBuilder(const SyntheticModel &model)
+      : m_model(model) {}
+
+  std::vector<uint8_t> build();
+
+private:
+  // Symbols 0 and 1 are the variables H and W.
+  static constexpr int64_t H = 0;
+  static constexpr int64_t W = 1;
+  static constexpr uint16_t VAR_COUNT = 2;
+  static constexpr uint32_t CHANNELS_PER_PIXEL_BYTES = 2;
+
+  int64_t op(uint16_t opcode, int64_t lhs, int64_t rhs) {
+    m_ops.emplace_back(static_cast<SymIROpCode>(opcode), lhs, rhs);
+    return VAR_COUNT + static_cast<int64_t>(m_ops.size()) - 1;
+  }
+
+  int64_t op_const(uint16_t opcode, int64_t lhs, int64_t rhs) {
+    return op(opcode | denox::dnx::SymIROpCode_RHSC, lhs, rhs);
+  }
+
+  /// Aligns the extent up to multiples of 8 with depth ops, such that the
+  /// symbolic IR grows with the depth without changing the value.
+  int64_t extent(int64_t var) {
+    int64_t sid = var;
+    for (uint32_t i = 0; i < m_model.symbolic_depth; ++i) {
+      switch (i % 3) {
+      case 0:
+        sid = op_const(denox::dnx::SymIROpCode_ADD, sid, 7);
+        break;
+      case 1:
+        sid = op_const(denox::dnx::SymIROpCode_DIV, sid, 8);
+        break;
+      case 2:
+        sid = op_const(denox::dnx::SymIROpCode_MUL, sid, 8);
+        break;
+      }
+    }
+    return sid;
+  }
+
+  Scalar symbol(int64_t sid) {
+    return Scalar{
+        .type = denox::dnx::ScalarSource_symbolic,
+        .value =
+            denox::dnx::CreateSymRef(m_fbb, static_cast<uint32_t>(sid))
+                .Union(),
+    };
+  }
+
+  Scalar literal(uint64_t value) {
+    uint8_t bytes[sizeof(uint64_t)];
+    std::memcpy(bytes, &value, sizeof(value));
+    return Scalar{
+        .type = denox::dnx::ScalarSource_literal,
+        .value = denox::dnx::CreateScalarLiteral(
+                     m_fbb, denox::dnx::ScalarType_U64,
+                     m_fbb.CreateVector(bytes, sizeof(bytes)))
+                     .Union(),
+    };
+  }
+
+  uint32_t add_buffer(Scalar size) {
+    m_buffers.push_back(denox::dnx::CreateBuffer(m_fbb, size.type, size.value,
+                                                 BUFFER_ALIGNMENT));
+    return m_buffers.size() - 1;
+  }
+
+  uint32_t add_tensor(uint32_t buffer, Scalar offset, Scalar size,
+                      int64_t width, int64_t height, const char *name) {
+    const Scalar w = symbol(width);
+    const Scalar h = symbol(height);
+    const Scalar c = literal(m_model.channels);
+    const auto info = denox::dnx::CreateTensorInfo(
+        m_fbb, w.type, w.value, h.type, h.value, c.type, c.value,
+        denox::dnx::TensorFormat_SSBO_HWC,
+        denox::dnx::TensorStorage_StorageBuffer, denox::dnx::ScalarType_F16,
+        name == nullptr ? 0 : m_fbb.CreateString(name));
+    m_tensors.push_back(denox::dnx::CreateTensor(
+        m_fbb, buffer, offset.type, offset.value, size.type, size.value,
+        info));
+    return m_tensors.size() - 1;
+  }
+
+  /// Tensor with its own buffer, which holds the whole tensor.
+  LayerTensor add_activation(int64_t size, int64_t width, int64_t height,
+                             const char *name = nullptr) {
+    const uint32_t buffer = add_buffer(symbol(size));
+    return LayerTensor{
+        .tensor = add_tensor(buffer, literal(0), symbol(size), width, height,
+                             name),
+        .buffer = buffer,
+    };
+  }
+
+  uint32_t add_weights(uint64_t size);
+
+  void add_dispatch(uint32_t index, std::span<const uint32_t> inputs,
+                    uint32_t weights, uint32_t output, int64_t width,
+                    int64_t height, int64_t output_size);
+
+  std::vector<uint32_t> shader_binary(uint32_t seed) const;
+
+  static constexpr uint16_t BUFFER_ALIGNMENT = 16;
+
+  const SyntheticModel &m_model;
+  flatbuffers::FlatBufferBuilder m_fbb{1 << 20};
+  std::vector<denox::dnx::SymIROp> m_ops;
+  std::vector<flatbuffers::Offset<denox::dnx::Buffer>> m_buffers;
+  std::vector<flatbuffers::Offset<denox::dnx::Tensor>> m_tensors;
+  std::vector<flatbuffers::Offset<denox::dnx::TensorInitializer>>
+      m_initializers;
+  std::vector<flatbuffers::Offset<denox::dnx::ComputeDispatch>> m_dispatches;
+  uint64_t m_weight_seed = 0x9e3779b97f4a7c15ull;
+};
+
+} // namespace
+
+/// Minimal compute kernel "main" with a local size of 8x8x1, the seed is
+/// stored as a constant, such that different seeds give distinct binaries.
+std::vector<uint32_t>
+SyntheticModelBuilder::shader_binary(uint32_t seed) const {
+  using namespace spirv;
+  enum : uint32_t { VOID = 1, FN, MAIN, LABEL, UINT, SEED, BOUND };
+  constexpr uint32_t CAPABILITY_SHADER = 1;
+  constexpr uint32_t ADDRESSING_LOGICAL = 0;
+  constexpr uint32_t MEMORY_MODEL_GLSL450 = 1;
+
+  Module module;
+  module.header = {MAGIC, 0x00010000, 0, BOUND, 0};
+  module.instructions.push_back(
+      make_instruction(OpCapability, {CAPABILITY_SHADER}));
+  module.instructions.push_back(make_instruction(
+      OpMemoryModel, {ADDRESSING_LOGICAL, MEMORY_MODEL_GLSL450}));
+  Instruction entry = make_instruction(OpEntryPoint,
+                                       {ExecutionModelGLCompute, MAIN});
+  append_string(entry.words, "main");
+  entry.words[0] =
+      (static_cast<uint32_t>(entry.words.size()) << 16) | OpEntryPoint;
+  module.instructions.push_back(std::move(entry));
+  module.instructions.push_back(make_instruction(
+      OpExecutionMode, {MAIN, ExecutionModeLocalSize, 8, 8, 1}));
+  module.instructions.push_back(make_instruction(OpTypeVoid, {VOID}));
+  module.instructions.push_back(make_instruction(OpTypeFunction, {FN, VOID}));
+  module.instructions.push_back(make_instruction(OpTypeInt, {UINT, 32, 0}));
+  module.instructions.push_back(
+      make_instruction(OpConstant, {UINT, SEED, seed}));
+  module.instructions.push_back(
+      make_instruction(OpFunction, {VOID, MAIN, 0, FN}));
+  module.instructions.push_back(make_instruction(OpLabel, {LABEL}));
+  module.instructions.push_back(make_instruction(OpReturn, {}));
+  module.instructions.push_back(make_instruction(OpFunctionEnd, {}));
+  return assemble(module);
+}
+
+uint32_t SyntheticModelBuilder::add_weights(uint64_t size) {
+  const uint32_t buffer = add_buffer(literal(size));
+  const uint32_t tensor = m_tensors.size();
+  add_tensor(buffer, literal(0), literal(size), W, H, nullptr);
+  // Pseudo random content, such that weights are not deduplicated.
+  std::vector<uint8_t> data(size);
+  for (auto &byte : data) {
+    m_weight_seed = m_weight_seed * 6364136223846793005ull + 1;
+    byte = static_cast<uint8_t>(m_weight_seed >> 56);
+  }
+  m_initializers.push_back(denox::dnx::CreateTensorInitializer(
+      m_fbb, tensor, m_fbb.CreateVector(data)));
+  return tensor;
+}
+
+void SyntheticModelBuilder::add_dispatch(uint32_t index,
+                                         std::span<const uint32_t> inputs,
+                                         uint32_t weights, uint32_t output,
+                                         int64_t width, int64_t height,
+                                         int64_t output_size) {
+  std::vector<flatbuffers::Offset<denox::dnx::DescriptorBinding>> bindings;
+  uint16_t binding = 0;
+  for (uint32_t input : inputs) {
+    bindings.push_back(denox::dnx::CreateDescriptorBinding(
+        m_fbb, binding++, denox::dnx::Access_ReadOnly, input));
+  }
+  bindings.push_back(denox::dnx::CreateDescriptorBinding(
+      m_fbb, binding++, denox::dnx::Access_ReadOnly, weights));
+  bindings.push_back(denox::dnx::CreateDescriptorBinding(
+      m_fbb, binding++, denox::dnx::Access_WriteOnly, output));
+  const auto set = denox::dnx::CreateDescriptorSetBinding(
+      m_fbb, 1, m_fbb.CreateVector(bindings));
+
+  const Scalar pc_width = symbol(width);
+  const Scalar pc_height = symbol(height);
+  const std::vector<flatbuffers::Offset<denox::dnx::PushConstantField>>
+      fields = {
+          denox::dnx::CreatePushConstantField(m_fbb,
+                                              denox::dnx::ScalarType_U32, 0,
+                                              pc_width.type, pc_width.value),
+          denox::dnx::CreatePushConstantField(
+              m_fbb, denox::dnx::ScalarType_U32, 4, pc_height.type,
+              pc_height.value),
+      };
+  const auto push_constant =
+      denox::dnx::CreatePushConstant(m_fbb, 8, m_fbb.CreateVector(fields));
+
+  const Scalar wg_x = symbol(op_const(
+      denox::dnx::SymIROpCode_DIV,
+      op_const(denox::dnx::SymIROpCode_ADD, width, 7), 8));
+  const Scalar wg_y = symbol(op_const(
+      denox::dnx::SymIROpCode_DIV,
+      op_const(denox::dnx::SymIROpCode_ADD, height, 7), 8));
+  const Scalar wg_z = literal(1);
+  const Scalar reads = symbol(op_const(denox::dnx::SymIROpCode_MUL,
+                                       output_size, inputs.size()));
+  const Scalar writes = symbol(output_size);
+  const auto info = denox::dnx::CreateDispatchInfo(
+      m_fbb, m_fbb.CreateString(fmt::format("conv{}", index)), 0,
+      m_fbb.CreateString("synthetic.comp"), reads.type, reads.value,
+      writes.type, writes.value);
+
+  m_dispatches.push_back(denox::dnx::CreateComputeDispatch(
+      m_fbb, index % std::max(m_model.shaders, 1u), wg_x.type, wg_x.value,
+      wg_y.type, wg_y.value, wg_z.type, wg_z.value, m_fbb.CreateString("main"),
+      m_fbb.CreateVector(&set, 1), push_constant, info));
+}
+
+std::vector<uint8_t> SyntheticModelBuilder::build() {
+  const uint32_t branches = std::max(m_model.branches, 1u);
+  if (m_model.dispatches < (branches == 1 ? 1 : branches + 1)) {
+    throw std::runtime_error(fmt::format(
+        "{} branches require at least {} dispatches.", branches,
+        branches + 1));
+  }
+  const uint32_t layers =
+      branches == 1 ? m_model.dispatches : (m_model.dispatches - 1) / branches;
+  const uint32_t dispatch_count =
+      branches == 1 ? layers : layers * branches + 1;
+  const uint64_t layer_weight_bytes =
+      std::max<uint64_t>(m_model.weight_bytes / dispatch_count, 16) & ~15ull;
+  const int64_t pixel_bytes = m_model.channels * CHANNELS_PER_PIXEL_BYTES;
+
+  auto tensor_size = [&](int64_t width, int64_t height) {
+    return op_const(denox::dnx::SymIROpCode_MUL,
+                    op(denox::dnx::SymIROpCode_MUL, width, height),
+                    pixel_bytes);
+  };
+
+  const LayerTensor input = add_activation(tensor_size(W, H), W, H, "input");
+  std::vector<std::vector<uint32_t>> branch_inputs(branches,
+                                                   {input.tensor});
+  uint32_t index = 0;
+  for (uint32_t layer = 0; layer < layers; ++layer) {
+    const bool last = branches == 1 && layer + 1 == layers;
+    const int64_t width = extent(W);
+    const int64_t height = extent(H);
+    const int64_t size = last ? tensor_size(W, H) : tensor_size(width, height);
+    const bool concat = branches > 1 && m_model.concat_every != 0 &&
+                        (layer + 1) % m_model.concat_every == 0 &&
+                        layer + 1 != layers;
+    if (concat) {
+      // Every branch writes a slice of one buffer, the next layer of every
+      // branch reads the whole buffer.
+      const int64_t total_size =
+          op_const(denox::dnx::SymIROpCode_MUL, size, branches);
+      const uint32_t buffer = add_buffer(symbol(total_size));
+      const uint32_t concatenated = add_tensor(
+          buffer, literal(0), symbol(total_size), width, height, nullptr);
+      for (uint32_t b = 0; b < branches; ++b) {
+        const Scalar offset =
+            b == 0 ? literal(0)
+                   : symbol(op_const(denox::dnx::SymIROpCode_MUL, size, b));
+        const uint32_t slice = add_tensor(buffer, offset, symbol(size), width,
+                                          height, nullptr);
+        add_dispatch(index++, branch_inputs[b],
+                     add_weights(layer_weight_bytes), slice, width, height,
+                     size);
+      }
+      for (auto &inputs : branch_inputs) {
+        inputs = {concatenated};
+      }
+      continue;
+    }
+    for (uint32_t b = 0; b < branches; ++b) {
+      const LayerTensor output =
+          last ? add_activation(size, W, H, "output")
+               : add_activation(size, width, height);
+      add_dispatch(index++, branch_inputs[b], add_weights(layer_weight_bytes),
+                   output.tensor, last ? W : width, last ? H : height, size);
+      branch_inputs[b] = {output.tensor};
+    }
+  }
+  uint32_t output_tensor = branch_inputs[0].front();
+  if (branches > 1) {
+    // The join reads the last tensor of every branch.
+    std::vector<uint32_t> joined;
+    for (const auto &inputs : branch_inputs) {
+      joined.insert(joined.end(), inputs.begin(), inputs.end());
+    }
+    std::ranges::sort(joined);
+    joined.erase(std::unique(joined.begin(), joined.end()), joined.end());
+    const int64_t size = tensor_size(W, H);
+    const LayerTensor output = add_activation(size, W, H, "output");
+    add_dispatch(index++, joined, add_weights(layer_weight_bytes),
+                 output.tensor, W, H, size);
+    output_tensor = output.tensor;
+  }
+
+  std::vector<flatbuffers::Offset<denox::dnx::ShaderBinary>> binaries;
+  for (uint32_t s = 0; s < std::max(m_model.shaders, 1u); ++s) {
+    binaries.push_back(denox::dnx::CreateShaderBinary(
+        m_fbb, m_fbb.CreateVector(shader_binary(s))));
+  }
+
+  const Scalar h = symbol(H);
+  const Scalar w = symbol(W);
+  const std::vector<flatbuffers::Offset<denox::dnx::ValueName>> value_names = {
+      denox::dnx::CreateValueName(m_fbb, m_fbb.CreateString("H"), h.type,
+                                  h.value),
+      denox::dnx::CreateValueName(m_fbb, m_fbb.CreateString("W"), w.type,
+                                  w.value),
+  };
+  const auto sym_ir = denox::dnx::CreateSymIR(
+      m_fbb, VAR_COUNT, m_fbb.CreateVectorOfStructs(m_ops));
+  const auto info = denox::dnx::CreateModelInfo(
+      m_fbb, m_fbb.CreateString("vkdt-denox-bench"), m_fbb.CreateString("0"),
+      m_fbb.CreateString(m_model.name));
+  const std::vector<uint32_t> inputs = {input.tensor};
+  const std::vector<uint32_t> outputs = {output_tensor};
+  const std::vector<uint32_t> required_features;
+  const auto root = denox::dnx::CreateModel(
+      m_fbb, denox::dnx::Version_DNX_VERSION_1_0,
+      m_fbb.CreateVector(required_features), info,
+      m_fbb.CreateVector(m_tensors), m_fbb.CreateVector(m_initializers),
+      m_fbb.CreateVector(inputs), m_fbb.CreateVector(outputs),
+      m_fbb.CreateVector(m_buffers), m_fbb.CreateVector(m_dispatches),
+      m_fbb.CreateVector(binaries), sym_ir,
+      m_fbb.CreateVector(value_names));
+  denox::dnx::FinishModelBuffer(m_fbb, root);
+  return std::vector<uint8_t>(m_fbb.GetBufferPointer(),
+                              m_fbb.GetBufferPointer() + m_fbb.GetSize());
+}
+
+} // namespace vkdt_denox
+
+std::vector<uint8_t>
+vkdt_denox::generate_synthetic_dnx(const SyntheticModel &model) {
+  SyntheticModelBuilder builder(model);
+  return builder.build();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+namespace vkdt_denox {
+
+/// Shape of a synthetic model. The generated .dnx follows the conventions of
+/// denox (named H and W extents, f16 HWC input and output, initialized weight
+/// buffers), such that every codegen stage accepts it. The shaders are empty
+/// compute kernels, the model is not meant to be executed.
+struct SyntheticModel {
+  std::string name;
+  uint32_t dispatches = 64;
+  // Independent chains of dispatches, which are joined by a final dispatch.
+  uint32_t branches = 1;
+  // Every n-th layer, the branches write into slices of a single buffer
+  // (concat in memory), which the next layer of every branch reads. 0
+  // disables concatenation.
+  uint32_t concat_every = 0;
+  // Number of symbolic ops of the extent expressions of every layer.
+  uint32_t symbolic_depth = 3;
+  uint64_t weight_bytes = uint64_t(1) << 20;
+  // Number of distinct shader binaries.
+  uint32_t shaders = 16;
+  uint32_t channels = 16;
+};
+
+/// Serializes a synthetic model into a .dnx flatbuffer.
+std::vector<uint8_t> generate_synthetic_dnx(const SyntheticModel &model);
+
+} // namespace vkdt_denox
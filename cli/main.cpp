@@ -1,150 +1,1118 @@
 #include "compress_weights.hpp"
 #include "compute_graph.hpp"
+#include "conversion_kernels.hpp"
+#include "cost_manifest.hpp"
 #include "denox_create_nodes.hpp"
+#include "denox_query_cost.hpp"
 #include "denox_read_source.hpp"
+#include "denox_roi.hpp"
+#include "denox_variants.hpp"
+#include "dnx_file.hpp"
+#include "fold_push_constants.hpp"
 #include "io.hpp"
+#include "lint.hpp"
+#include "merge_bindings.hpp"
+#include "output_writer.hpp"
 #include "shader_registry.hpp"
 #include "source_writer.hpp"
+#include "split_dispatches.hpp"
+#include "strip_shaders.hpp"
 #include "symbolics.hpp"
+#include "task_pool.hpp"
 #include <CLI/CLI.hpp>
+#include <algorithm>
+#include <cstdio>
 #include <dnx.h>
+#include <exception>
 #include <filesystem>
 #include <fmt/format.h>
+#include <future>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+/// Parses a value for every symbolic extent from NAME=<value> pairs.
+static std::optional<std::vector<int64_t>>
+parse_extents(const vkdt_denox::SymbolicIR &symbolic_ir,
+              const std::vector<std::string> &defines) {
+  std::vector<int64_t> vars(symbolic_ir.vars.size());
+  std::vector<bool> defined(symbolic_ir.vars.size(), false);
+  for (const auto &define : defines) {
+    const auto eq = define.find('=');
+    const std::string name = define.substr(0, eq);
+    auto it = std::ranges::find(symbolic_ir.vars, name);
+    std::optional<int64_t> value;
+    if (eq != std::string::npos) {
+      const std::string digits = define.substr(eq + 1);
+      try {
+        std::size_t end = 0;
+        value = std::stoll(digits, &end);
+        if (end != digits.size()) {
+          value = std::nullopt;
+        }
+      } catch (const std::exception &) {
+        value = std::nullopt;
+      }
+    }
+    if (!value.has_value() || it == symbolic_ir.vars.end()) {
+      std::cerr << "Error: invalid extent " << define << ", expected one of";
+      for (const auto &var : symbolic_ir.vars) {
+        std::cerr << ' ' << var << "=<value>";
+      }
+      std::cerr << '\n';
+      return std::nullopt;
+    }
+    const std::size_t index = it - symbolic_ir.vars.begin();
+    vars[index] = *value;
+    defined[index] = true;
+  }
+  for (std::size_t i = 0; i < vars.size(); ++i) {
+    if (!defined[i]) {
+      std::cerr << "Error: missing value for extent " << symbolic_ir.vars[i]
+                << " (" << symbolic_ir.vars[i] << "=<value>)\n";
+      return std::nullopt;
+    }
+  }
+  return vars;
+}
+
+/// Prints the workgroup counts and memory traffic of every dispatch for the
+/// given values of the symbolic extents (e.g. H=1080).
+static int print_dispatch_costs(const fs::path &dnx_path,
+                                const std::vector<std::string> &defines,
+                                bool verify_dnx) {
+  // The weights are never touched, such that they are not read from disk.
+  const vkdt_denox::DnxFile dnx_file =
+      vkdt_denox::read_dnx_file(dnx_path, verify_dnx);
+  const auto *dnx = dnx_file.model;
+  vkdt_denox::SymbolicIR symbolic_ir = vkdt_denox::read_symbolic_ir(dnx);
+
+  std::optional<std::vector<int64_t>> vars =
+      parse_extents(symbolic_ir, defines);
+  if (!vars.has_value()) {
+    return 1;
+  }
+
+  vkdt_denox::CompressedWeights compressed_weights =
+      vkdt_denox::compress_weights(dnx);
+  vkdt_denox::ShaderRegistry shader_registry =
+      vkdt_denox::create_shader_registry(dnx);
+  vkdt_denox::ComputeGraph compute_graph =
+      vkdt_denox::reconstruct_compute_graph(dnx, compressed_weights,
+                                            shader_registry);
+
+  auto bytes = [](const std::optional<int64_t> &value) {
+    return value.has_value() ? fmt::format("{}", *value) : std::string("-");
+  };
+  fmt::println("{:<40} {:<10} {:>20} {:>14} {:>14}", "node", "shader",
+               "workgroups", "reads", "writes");
+  int64_t total_reads = 0;
+  int64_t total_writes = 0;
+  for (const auto &cost : vkdt_denox::evaluate_dispatch_costs(
+           symbolic_ir, compute_graph, shader_registry, *vars)) {
+    fmt::println("{:<40} {:<10} {:>20} {:>14} {:>14}", cost.node, cost.shader,
+                 fmt::format("{}x{}x{}", cost.workgroup_count[0],
+                             cost.workgroup_count[1], cost.workgroup_count[2]),
+                 bytes(cost.memory_reads), bytes(cost.memory_writes));
+    total_reads += cost.memory_reads.value_or(0);
+    total_writes += cost.memory_writes.value_or(0);
+  }
+  fmt::println("{:<40} {:<10} {:>20} {:>14} {:>14}", "total", "", "",
+               total_reads, total_writes);
+  return 0;
+}
+
+/// Writes a JSON report of the performance pitfalls of the compute graph
+/// (see lint.hpp) for every resolution, given as comma separated extents
+/// (e.g. H=1080,W=1920). Returns 2 in strict mode if anything is reported.
+static int lint_dnx(const fs::path &dnx_path,
+                    const std::vector<std::string> &resolutions,
+                    const vkdt_denox::LintOptions &options,
+                    const std::string &output, bool strict, bool verify_dnx) {
+  const vkdt_denox::DnxFile dnx_file =
+      vkdt_denox::read_dnx_file(dnx_path, verify_dnx);
+  const auto *dnx = dnx_file.model;
+  vkdt_denox::SymbolicIR symbolic_ir = vkdt_denox::read_symbolic_ir(dnx);
+
+  std::vector<std::vector<int64_t>> vars;
+  for (const auto &resolution : resolutions) {
+    std::vector<std::string> defines;
+    std::stringstream ss(resolution);
+    std::string define;
+    while (std::getline(ss, define, ',')) {
+      defines.push_back(define);
+    }
+    std::optional<std::vector<int64_t>> values =
+        parse_extents(symbolic_ir, defines);
+    if (!values.has_value()) {
+      return 1;
+    }
+    vars.push_back(std::move(*values));
+  }
+
+  vkdt_denox::CompressedWeights compressed_weights =
+      vkdt_denox::compress_weights(dnx);
+  vkdt_denox::ShaderRegistry shader_registry =
+      vkdt_denox::create_shader_registry(dnx);
+  vkdt_denox::ComputeGraph compute_graph =
+      vkdt_denox::reconstruct_compute_graph(dnx, compressed_weights,
+                                            shader_registry);
+
+  const std::vector<vkdt_denox::LintFinding> findings =
+      vkdt_denox::lint_compute_graph(symbolic_ir, compute_graph,
+                                     compressed_weights, shader_registry, vars,
+                                     options);
+  const std::string report =
+      vkdt_denox::create_lint_report(symbolic_ir, vars, findings);
+  if (output.empty()) {
+    std::cout << report;
+  } else {
+    vkdt_denox::write_file(output, report);
+  }
+  return strict && !findings.empty() ? 2 : 0;
+}
+
+/// Parses "multiple:<pixels>" or "geometric:<growth>" (e.g. geometric:1.25).
+static std::optional<vkdt_denox::ExtentBuckets>
+parse_extent_buckets(const std::string &spec) {
+  const auto colon = spec.find(':');
+  if (colon == std::string::npos) {
+    return std::nullopt;
+  }
+  const std::string kind = spec.substr(0, colon);
+  const std::string value = spec.substr(colon + 1);
+  vkdt_denox::ExtentBuckets buckets;
+  try {
+    if (kind == "multiple") {
+      const unsigned long multiple = std::stoul(value);
+      if (multiple == 0 || multiple > UINT32_MAX) {
+        return std::nullopt;
+      }
+      buckets.kind = vkdt_denox::ExtentBucketKind::Multiple;
+      buckets.multiple = static_cast<uint32_t>(multiple);
+    } else if (kind == "geometric") {
+      const double growth = std::stod(value);
+      // growth factors below 1.001 would never leave the first bucket.
+      if (!(growth >= 1.001 && growth <= 16.0)) {
+        return std::nullopt;
+      }
+      buckets.kind = vkdt_denox::ExtentBucketKind::Geometric;
+      buckets.growth_permille = static_cast<uint32_t>(growth * 1000.0 + 0.5);
+    } else {
+      return std::nullopt;
+    }
+  } catch (const std::exception &) {
+    return std::nullopt;
+  }
+  return buckets;
+}
+
+namespace {
+
+/// Settings, which apply to every generated module.
+struct CodegenOptions {
+  bool mkdir = false;
+  bool fold_push_constants = false;
+  std::size_t fold_budget = 1 << 20;
+  bool strip_shaders = false;
+  bool merge_bindings = false;
+  uint32_t max_workgroup_count = 0;
+  vkdt_denox::ExtentBuckets extent_buckets;
+  std::string preprocessing;
+  std::string postprocessing;
+  bool convert_layouts = false;
+};
+
+/// Artifacts and output directories of a generated module.
+struct ModuleSpec {
+  std::string module_name;
+  // <path>[@<extent>=<value>,...], one per variant.
+  std::vector<std::string> dnx_specs;
+  fs::path src_dir;
+  fs::path shader_dir;
+  fs::path weight_dir;
+  fs::path bin_dir;
+};
+
+/// A module after preprocessing, ready for code generation.
+struct PreparedModule {
+  const ModuleSpec *spec;
+  std::vector<fs::path> dnx_paths;
+  std::vector<const denox::dnx::Model *> dnxs;
+  std::vector<vkdt_denox::SymbolicIR> symbolic_irs;
+  std::vector<vkdt_denox::VariantTarget> targets;
+  std::vector<vkdt_denox::CompressedWeights> compressed_weights;
+  std::vector<vkdt_denox::ComputeGraph> compute_graphs;
+  // Binaries of all variants.
+  vkdt_denox::ShaderRegistry shader_registry;
+  // Weight file of another module with identical weights, which is loaded
+  // instead of writing a copy (batch).
+  std::optional<fs::path> shared_weight_path;
+};
+
+/// Maps every .dnx once, modules of a batch, which embed the same artifact,
+/// share the mapping.
+class DnxCache {
+public:
+  explicit DnxCache(bool verify) : m_verify(verify) {}
+
+  const denox::dnx::Model *load(const fs::path &path) {
+    const std::string key = fs::weakly_canonical(path).string();
+    // The first caller maps (and verifies) the file outside of the lock,
+    // later callers of the same path wait for its result.
+    std::promise<vkdt_denox::DnxFile> promise;
+    std::shared_future<vkdt_denox::DnxFile> file;
+    bool first = false;
+    {
+      std::lock_guard lock{m_mutex};
+      auto [it, inserted] = m_files.try_emplace(key);
+      if (inserted) {
+        it->second = promise.get_future().share();
+        first = true;
+      }
+      file = it->second;
+    }
+    if (first) {
+      try {
+        promise.set_value(vkdt_denox::read_dnx_file(path, m_verify));
+      } catch (...) {
+        promise.set_exception(std::current_exception());
+      }
+    }
+    return file.get().model;
+  }
+
+private:
+  bool m_verify;
+  std::mutex m_mutex;
+  std::map<std::string, std::shared_future<vkdt_denox::DnxFile>> m_files;
+};
+
+} // namespace
+
+static bool check_output_dir(const fs::path &dir, const char *name,
+                             bool mkdir) {
+  if (fs::exists(dir)) {
+    if (!fs::is_directory(dir)) {
+      std::cerr << "Error: " << name
+                << " exists but is not a directory: " << dir << '\n';
+      return false;
+    }
+    return true;
+  }
+
+  if (!mkdir) {
+    std::cerr << "Error: " << name << " does not exist: " << dir << '\n'
+              << "       Use --mkdir (-p) to create it.\n";
+    return false;
+  }
+
+  std::error_code ec;
+  if (!fs::create_directories(dir, ec)) {
+    std::cerr << "Error: failed to create directory " << dir << ": "
+              << ec.message() << '\n';
+    return false;
+  }
+
+  return true;
+}
+
+static fs::path module_weight_path(const ModuleSpec &spec) {
+  return spec.weight_dir / fmt::format("{}-weights.dat", spec.module_name);
+}
+
+/// Loads the variants of a module and runs all passes, which precede the code
+/// generation. Processing stage kernels are written to the shader directory.
+static std::optional<PreparedModule>
+prepare_module(const ModuleSpec &spec, const CodegenOptions &options,
+               DnxCache &dnx_cache, vkdt_denox::OutputWriter &output_writer,
+               vkdt_denox::TaskPool &task_pool) {
+  PreparedModule module;
+  module.spec = &spec;
+
+  // ---- Filesystem validation ----
+
+  // Variants are given as <path>@<extent>=<value>,...
+  std::vector<std::string> variant_targets;
+  for (const auto &dnx_spec : spec.dnx_specs) {
+    const auto at = dnx_spec.rfind('@');
+    module.dnx_paths.emplace_back(dnx_spec.substr(0, at));
+    variant_targets.push_back(at == std::string::npos
+                                  ? std::string()
+                                  : dnx_spec.substr(at + 1));
+  }
+  const std::vector<fs::path> &dnx_paths = module.dnx_paths;
+
+  for (const auto &dnx_path : dnx_paths) {
+    if (!fs::exists(dnx_path) || !fs::is_regular_file(dnx_path)) {
+      std::cerr
+          << "Error: DNX artifact does not exist or is not a regular file: "
+          << dnx_path << '\n';
+      return std::nullopt;
+    }
+  }
+
+  if (!check_output_dir(spec.src_dir, "src-dir", options.mkdir) ||
+      !check_output_dir(spec.shader_dir, "shader-dir", options.mkdir) ||
+      !check_output_dir(spec.weight_dir, "weight-dir", options.mkdir) ||
+      !check_output_dir(spec.bin_dir, "bin-dir", options.mkdir)) {
+    return std::nullopt;
+  }
+
+  // Load dnx artifacts, each one is a variant of the module. The artifacts
+  // are mapped, shader binaries and initializers are read from the mapping.
+  const std::size_t variant_count = dnx_paths.size();
+  std::vector<const denox::dnx::Model *> &dnxs = module.dnxs;
+  dnxs.resize(variant_count);
+  task_pool.parallel_for(variant_count, [&](std::size_t v) {
+    dnxs[v] = dnx_cache.load(dnx_paths[v]);
+  });
+  std::vector<vkdt_denox::SymbolicIR> &symbolic_irs = module.symbolic_irs;
+  for (std::size_t v = 0; v < variant_count; ++v) {
+    symbolic_irs.push_back(vkdt_denox::read_symbolic_ir(dnxs[v]));
+    if (symbolic_irs.back().vars != symbolic_irs.front().vars) {
+      std::cerr << "Error: " << dnx_paths[v]
+                << " has different extents than the first variant\n";
+      return std::nullopt;
+    }
+  }
+
+  std::vector<vkdt_denox::VariantTarget> &targets = module.targets;
+  if (variant_count > 1) {
+    for (std::size_t v = 0; v < variant_count; ++v) {
+      vkdt_denox::VariantTarget target;
+      target.cooperative_matrix =
+          vkdt_denox::requires_cooperative_matrix(dnxs[v]);
+      // Variants, which are the only one with their features, are also
+      // selected without a target (e.g. a cooperative matrix variant and its
+      // portable fallback).
+      const bool unique_features =
+          std::ranges::count_if(dnxs, [&](const auto *dnx) {
+            return vkdt_denox::requires_cooperative_matrix(dnx) ==
+                   target.cooperative_matrix;
+          }) == 1;
+      if (variant_targets[v].empty() && unique_features) {
+        targets.push_back(std::move(target));
+        continue;
+      }
+
+      std::vector<std::string> defines;
+      for (std::size_t begin = 0; begin < variant_targets[v].size();) {
+        std::size_t end = variant_targets[v].find(',', begin);
+        end = end == std::string::npos ? variant_targets[v].size() : end;
+        defines.push_back(variant_targets[v].substr(begin, end - begin));
+        begin = end + 1;
+      }
+      auto extents = parse_extents(symbolic_irs[v], defines);
+      if (!extents.has_value()) {
+        std::cerr << "Error: variant " << dnx_paths[v]
+                  << " requires a target, e.g. " << dnx_paths[v].string()
+                  << "@H=1080,W=1920\n";
+        return std::nullopt;
+      }
+      for (int64_t extent : *extents) {
+        if (extent <= 0) {
+          std::cerr << "Error: variant targets must be positive\n";
+          return std::nullopt;
+        }
+        target.extents.push_back(static_cast<uint64_t>(extent));
+      }
+      targets.push_back(std::move(target));
+    }
+  } else if (vkdt_denox::requires_cooperative_matrix(dnxs.front())) {
+    fmt::println(stderr,
+                 "Warning: {} requires cooperative matrices, pass a portable "
+                 "fallback .dnx to support devices without them.",
+                 dnx_paths.front().string());
+  }
+
+  // Preprocessing for codegeneration
+  // The shader registries do not depend on the weights, they are created
+  // while the shared weight layout is computed.
+  std::vector<vkdt_denox::ShaderRegistry> shader_registries(variant_count);
+  std::vector<std::future<void>> registry_tasks;
+  vkdt_denox::FutureGuard registry_guard(registry_tasks);
+  for (std::size_t v = 0; v < variant_count; ++v) {
+    registry_tasks.push_back(task_pool.submit([&, v] {
+      shader_registries[v] = vkdt_denox::create_shader_registry(dnxs[v]);
+    }));
+  }
+  // All variants upload the same weight file, identical weights are shared.
+  std::vector<vkdt_denox::CompressedWeights> &compressed_weights =
+      module.compressed_weights;
+  compressed_weights = vkdt_denox::compress_shared_weights(dnxs, &task_pool);
+  for (auto &task : registry_tasks) {
+    task.get();
+  }
+
+  std::vector<vkdt_denox::ComputeGraph> &compute_graphs =
+      module.compute_graphs;
+  compute_graphs.resize(variant_count);
+  std::vector<std::future<void>> variant_tasks;
+  vkdt_denox::FutureGuard variant_guard(variant_tasks);
+  for (std::size_t v = 0; v < variant_count; ++v) {
+    variant_tasks.push_back(task_pool.submit([&, v] {
+      vkdt_denox::ShaderRegistry &shader_registry = shader_registries[v];
+      vkdt_denox::ComputeGraph &compute_graph = compute_graphs[v];
+      compute_graph = vkdt_denox::reconstruct_compute_graph(
+          dnxs[v], compressed_weights[v], shader_registry);
+
+      if (options.merge_bindings) {
+        vkdt_denox::BindingMerging merging =
+            vkdt_denox::merge_buffer_bindings(compute_graph, shader_registry);
+        fmt::println("merged {} bindings into the connectors of their "
+                     "buffers ({} rewritten shaders)",
+                     merging.merged_bindings, merging.rewritten_binaries);
+      }
+
+      if (options.max_workgroup_count != 0) {
+        vkdt_denox::DispatchSplitting splitting =
+            vkdt_denox::split_oversized_dispatches(
+                compute_graph, shader_registry, options.max_workgroup_count);
+        fmt::println("split {} dispatches exceeding {} workgroups ({} "
+                     "rewritten shaders)",
+                     splitting.split_dispatches, options.max_workgroup_count,
+                     splitting.rewritten_binaries);
+      }
+
+      if (options.fold_push_constants) {
+        vkdt_denox::PushConstantFolding folding =
+            vkdt_denox::fold_literal_push_constants(
+                compute_graph, shader_registry, options.fold_budget);
+        fmt::println("folded {} push constant loads into {} shader "
+                     "variants (+{} bytes)",
+                     folding.folded_loads, folding.variants,
+                     folding.variant_bytes);
+      }
+
+      if (options.strip_shaders) {
+        for (const auto &shader : vkdt_denox::strip_shader_binaries(
+                 compute_graph, shader_registry)) {
+          fmt::println("stripped {}: {} -> {} bytes", shader.name,
+                       shader.bytes_before, shader.bytes_after);
+        }
+      }
+    }));
+  }
+  for (auto &task : variant_tasks) {
+    task.get();
+  }
+
+  for (std::size_t v = 0; v < variant_count; ++v) {
+    const vkdt_denox::ComputeGraph &compute_graph = compute_graphs[v];
+    auto same_connectors = [](const auto &lhs, const auto &rhs) {
+      return std::ranges::equal(lhs, rhs, [](const auto &a, const auto &b) {
+        return a.name == b.name && a.format == b.format;
+      });
+    };
+    if (!same_connectors(compute_graph.input_descriptors,
+                         compute_graphs.front().input_descriptors) ||
+        !same_connectors(compute_graph.output_descriptors,
+                         compute_graphs.front().output_descriptors)) {
+      std::cerr << "Error: " << dnx_paths[v]
+                << " has different inputs or outputs than the first "
+                   "variant\n";
+      return std::nullopt;
+    }
+  }
+
+  // Processing stages are compiled by vkdt, the kernel names are disjoint
+  // from the content addressed names of the registry.
+  auto add_processing_stage = [&](const std::string &path,
+                                  const std::string &kernel, bool inputs) {
+    if (path.empty()) {
+      return;
+    }
+    output_writer.write(spec.shader_dir / (kernel + ".comp"),
+                        vkdt_denox::read_file(path));
+    for (auto &compute_graph : compute_graphs) {
+      for (auto &descriptor : inputs ? compute_graph.input_descriptors
+                                     : compute_graph.output_descriptors) {
+        descriptor.stage_kernel = kernel;
+      }
+    }
+  };
+  add_processing_stage(options.preprocessing, "pre", true);
+  add_processing_stage(options.postprocessing, "post", false);
+  if (options.convert_layouts) {
+    std::set<std::string> written_kernels;
+    for (auto &compute_graph : compute_graphs) {
+      for (auto *descriptors : {&compute_graph.input_descriptors,
+                                &compute_graph.output_descriptors}) {
+        for (auto &descriptor : *descriptors) {
+          if (descriptor.stage_kernel.has_value()) {
+            continue;
+          }
+          vkdt_denox::ConversionKernel kernel =
+              vkdt_denox::create_conversion_kernel(descriptor.layout,
+                                                   descriptor.type);
+          if (written_kernels.insert(kernel.name).second) {
+            output_writer.write(spec.shader_dir / (kernel.name + ".comp"),
+                                kernel.source);
+          }
+          descriptor.stage_kernel = kernel.name;
+        }
+      }
+    }
+  }
+
+  // Variants share a single registry, such that identical shaders are only
+  // written once.
+  module.shader_registry =
+      variant_count == 1 ? std::move(shader_registries.front())
+                         : vkdt_denox::merge_shader_registries(
+                               shader_registries, compute_graphs);
+  if (variant_count > 1) {
+    fmt::println("{} variants share {} shaders and {} weight bytes",
+                 variant_count, module.shader_registry.binaries.size(),
+                 compressed_weights.front().byte_size);
+  }
+  return module;
+}
+
+/// Writes the weights, the shaders and the generated source of a module.
+/// Binaries of a registry, which belongs to another vkdt module, are not
+/// written.
+static void emit_module(const PreparedModule &module,
+                        const vkdt_denox::ShaderRegistry &shader_registry,
+                        const CodegenOptions &options,
+                        vkdt_denox::OutputWriter &output_writer,
+                        vkdt_denox::TaskPool &task_pool) {
+  const ModuleSpec &spec = *module.spec;
+  const std::string &module_name = spec.module_name;
+  const std::size_t variant_count = module.dnxs.size();
+  const auto &dnxs = module.dnxs;
+  const auto &symbolic_irs = module.symbolic_irs;
+  const auto &compressed_weights = module.compressed_weights;
+  const auto &compute_graphs = module.compute_graphs;
+
+  fs::path weight_path =
+      module.shared_weight_path.value_or(module_weight_path(spec));
+  std::string rel_weight_path_str =
+      fs::relative(weight_path, spec.bin_dir).string();
+  fmt::println("relative-path: {}", rel_weight_path_str);
+
+  // Weights and shaders are written concurrently with the code generation.
+  std::vector<std::future<bool>> writes;
+  vkdt_denox::FutureGuard write_guard(writes);
+  if (!module.shared_weight_path.has_value()) {
+    writes.push_back(task_pool.submit([&] {
+      // Streamed from the dnx mappings, the weights are never assembled in
+      // memory.
+      return output_writer.write(weight_path,
+                                 compressed_weights.front().chunks);
+    }));
+  }
+
+  vkdt_denox::SourceWriter src;
+  src.add_header_guard(fmt::format("{}_DENOX_MODULE_H", module_name));
+  src.append("\n");
+
+  if (shader_registry.module.empty()) {
+    for (const auto &binary : shader_registry.binaries) {
+      writes.push_back(task_pool.submit([&] {
+        return output_writer.write(
+            spec.shader_dir / (binary.name + ".comp.spv"), binary.spv.data(),
+            binary.spv.size() * sizeof(uint32_t));
+      }));
+    }
+  }
+
+  vkdt_denox::def_func_denox_read_source(
+      src, compute_graphs.front(), compressed_weights.front(),
+      rel_weight_path_str, module_name);
+
+  src.append("\n");
+  if (options.extent_buckets.kind != vkdt_denox::ExtentBucketKind::None &&
+      !symbolic_irs.front().vars.empty()) {
+    vkdt_denox::def_func_denox_extent_bucket(src, options.extent_buckets);
+    src.append("\n");
+  }
+  vkdt_denox::def_struct_denox_cost(src);
+  src.append("\n");
+  if (variant_count == 1) {
+    vkdt_denox::def_func_denox_create_nodes(
+        src, dnxs.front(), symbolic_irs.front(), shader_registry,
+        compressed_weights.front(), compute_graphs.front(), module_name,
+        options.extent_buckets);
+    src.append("\n");
+    vkdt_denox::def_func_denox_query_cost(
+        src, symbolic_irs.front(), compute_graphs.front(),
+        compressed_weights.front(), options.extent_buckets);
+    src.append("\n");
+  } else {
+    for (std::size_t v = 0; v < variant_count; ++v) {
+      vkdt_denox::def_func_denox_create_nodes(
+          src, dnxs[v], symbolic_irs[v], shader_registry,
+          compressed_weights[v], compute_graphs[v], module_name,
+          options.extent_buckets, fmt::format("denox_create_nodes_v{}", v));
+      src.append("\n");
+      vkdt_denox::def_func_denox_query_cost(
+          src, symbolic_irs[v], compute_graphs[v], compressed_weights[v],
+          options.extent_buckets, fmt::format("denox_query_cost_v{}", v));
+      src.append("\n");
+    }
+    vkdt_denox::def_func_denox_variants(src, symbolic_irs.front(),
+                                        compute_graphs.front(),
+                                        module.targets);
+    src.append("\n");
+  }
+  vkdt_denox::def_func_denox_roi(src, dnxs.front(), symbolic_irs.front());
+  src.append("\n");
+
+  fs::path src_path = spec.src_dir / "denox_model.h";
+  output_writer.write(src_path, src.finish());
+
+  for (std::size_t v = 0; v < variant_count; ++v) {
+    fs::path manifest_path =
+        spec.src_dir / (variant_count == 1
+                            ? std::string("denox_model.json")
+                            : fmt::format("denox_model_v{}.json", v));
+    output_writer.write(manifest_path,
+                        vkdt_denox::create_cost_manifest(
+                            symbolic_irs[v], compute_graphs[v],
+                            shader_registry, module_name));
+  }
+  for (auto &write : writes) {
+    write.get();
+  }
+}
+
+/// Parses a batch manifest. Every non-empty line, which does not start with
+/// '#', describes one module:
+///   module=<name> src=<dir> shaders=<dir> weights=<dir> bin=<dir>
+///   dnx=<path>[@<extent>=<value>,...] [dnx=...]
+/// Relative paths are relative to the manifest.
+static std::optional<std::vector<ModuleSpec>>
+parse_batch_manifest(const fs::path &manifest_path) {
+  const fs::path base = manifest_path.parent_path();
+  std::istringstream manifest(vkdt_denox::read_file(manifest_path.string()));
+  std::vector<ModuleSpec> modules;
+  std::string line;
+  for (std::size_t line_number = 1; std::getline(manifest, line);
+       ++line_number) {
+    std::istringstream fields(line);
+    std::string field;
+    if (!(fields >> field) || field.front() == '#') {
+      continue;
+    }
+    ModuleSpec spec;
+    std::set<std::string> keys;
+    do {
+      const auto eq = field.find('=');
+      const std::string key = field.substr(0, eq);
+      const std::string value =
+          eq == std::string::npos ? std::string() : field.substr(eq + 1);
+      if (key == "module") {
+        spec.module_name = value;
+      } else if (key == "src") {
+        spec.src_dir = base / value;
+      } else if (key == "shaders") {
+        spec.shader_dir = base / value;
+      } else if (key == "weights") {
+        spec.weight_dir = base / value;
+      } else if (key == "bin") {
+        spec.bin_dir = base / value;
+      } else if (key == "dnx") {
+        spec.dnx_specs.push_back((base / value).string());
+      } else {
+        std::cerr << "Error: " << manifest_path.string() << ':'
+                  << line_number << ": unknown field " << field << '\n';
+        return std::nullopt;
+      }
+      if (value.empty()) {
+        std::cerr << "Error: " << manifest_path.string() << ':'
+                  << line_number << ": missing value of " << key << '\n';
+        return std::nullopt;
+      }
+      keys.insert(key);
+    } while (fields >> field);
+    for (const char *key : {"module", "src", "shaders", "weights", "bin",
+                            "dnx"}) {
+      if (!keys.contains(key)) {
+        std::cerr << "Error: " << manifest_path.string() << ':'
+                  << line_number << ": missing " << key << "=\n";
+        return std::nullopt;
+      }
+    }
+    modules.push_back(std::move(spec));
+  }
+  return modules;
+}
+
+/// Generates all modules of a batch manifest in one process. Modules are
+/// prepared and emitted in parallel, every .dnx is mapped once, modules with
+/// identical weights share one weight file and with a shared shader module,
+/// identical kernels of all modules are written once.
+static int run_batch(const fs::path &manifest_path,
+                     const CodegenOptions &options, std::size_t jobs,
+                     bool verify_dnx,
+                     const std::optional<fs::path> &hash_manifest,
+                     const std::string &shared_shader_module,
+                     const fs::path &shared_shader_dir) {
+  std::optional<std::vector<ModuleSpec>> specs =
+      parse_batch_manifest(manifest_path);
+  if (!specs.has_value()) {
+    return 1;
+  }
+  // Modules write files of the same name into their directories.
+  std::set<std::string> module_names;
+  std::set<fs::path> src_dirs;
+  std::set<fs::path> shader_dirs;
+  for (const auto &spec : *specs) {
+    if (!module_names.insert(spec.module_name).second ||
+        !src_dirs.insert(fs::weakly_canonical(spec.src_dir)).second ||
+        !shader_dirs.insert(fs::weakly_canonical(spec.shader_dir)).second) {
+      std::cerr << "Error: module " << spec.module_name
+                << " shares its name, src or shaders directory with another "
+                   "module\n";
+      return 1;
+    }
+  }
+  const bool shared_shaders = !shared_shader_module.empty();
+  if (shared_shaders &&
+      !check_output_dir(shared_shader_dir, "shared-shader-dir",
+                        options.mkdir)) {
+    return 1;
+  }
+
+  vkdt_denox::OutputWriter output_writer(hash_manifest);
+  vkdt_denox::TaskPool task_pool(jobs);
+  DnxCache dnx_cache(verify_dnx);
+
+  // Modules are distributed over the pool, the stages of a module run
+  // sequentially, as tasks must not wait for tasks of the same pool.
+  auto for_each_module = [&](auto &&fn) {
+    std::vector<std::future<void>> tasks;
+    for (std::size_t m = 0; m < specs->size(); ++m) {
+      tasks.push_back(task_pool.submit([&fn, m] {
+        vkdt_denox::TaskPool sequential(1);
+        fn(m, sequential);
+      }));
+    }
+    // All tasks are awaited before an exception is rethrown, as they
+    // reference the modules.
+    std::exception_ptr error;
+    for (auto &task : tasks) {
+      try {
+        task.get();
+      } catch (...) {
+        error = error ? error : std::current_exception();
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  };
+
+  std::vector<std::optional<PreparedModule>> modules(specs->size());
+  for_each_module([&](std::size_t m, vkdt_denox::TaskPool &pool) {
+    modules[m] =
+        prepare_module((*specs)[m], options, dnx_cache, output_writer, pool);
+  });
+  if (std::ranges::any_of(modules, [](const auto &m) { return !m; })) {
+    return 1;
+  }
+
+  // Modules with identical weights load the weight file of the first one.
+  std::vector<const PreparedModule *> weight_owners;
+  for (auto &module : modules) {
+    for (const auto *owner : weight_owners) {
+      if (vkdt_denox::equal_weights(module->compressed_weights.front(),
+                                    owner->compressed_weights.front())) {
+        module->shared_weight_path = module_weight_path(*owner->spec);
+        break;
+      }
+    }
+    if (!module->shared_weight_path.has_value()) {
+      weight_owners.push_back(&*module);
+    }
+  }
+
+  // Content addressed store of the kernels of all modules.
+  vkdt_denox::ShaderRegistry shader_store;
+  shader_store.module = shared_shader_module;
+  std::size_t module_shaders = 0;
+  if (shared_shaders) {
+    for (auto &module : modules) {
+      module_shaders += module->shader_registry.binaries.size();
+      vkdt_denox::merge_into_shader_registry(
+          shader_store, module->shader_registry, module->compute_graphs);
+    }
+    for (const auto &binary : shader_store.binaries) {
+      output_writer.write(shared_shader_dir / (binary.name + ".comp.spv"),
+                          binary.spv.data(),
+                          binary.spv.size() * sizeof(uint32_t));
+    }
+  }
+
+  for_each_module([&](std::size_t m, vkdt_denox::TaskPool &pool) {
+    const PreparedModule &module = *modules[m];
+    emit_module(module, shared_shaders ? shader_store : module.shader_registry,
+                options, output_writer, pool);
+  });
+
+  output_writer.finish();
+  fmt::println("generated {} modules with {} weight files", modules.size(),
+               weight_owners.size());
+  if (shared_shaders) {
+    fmt::println("{} kernels of all modules are stored as {} shared kernels "
+                 "in {}",
+                 module_shaders, shader_store.binaries.size(),
+                 shared_shader_module);
+  }
+  fmt::println("wrote {} files, {} unchanged", output_writer.written(),
+               output_writer.unchanged());
+  return 0;
+}
+
 int main(int argc, char **argv) {
   CLI::App app{
       "vkdt-denox — C code generator for vkdt from compiled CNN artifacts"};
 
-  std::string dnx_path_str;
+  CodegenOptions options;
+  std::vector<std::string> dnx_specs;
   std::string src_dir_str;
   std::string shader_dir_str;
   std::string weight_dir_str;
   std::string bin_dir_str;
   std::string module_name;
-  bool mkdir = false;
+  std::string extent_buckets_str;
+  std::string hash_manifest_str;
+  std::size_t jobs = 1;
+  bool verify_dnx = false;
 
   // Positional: DNX artifact
-  app.add_option("dnx", dnx_path_str, "Compiled neural network artifact (.dnx)")
-      ->required();
+  // Required unless a subcommand is given, validated after parsing.
+  std::vector<CLI::Option *> required_options;
+  required_options.push_back(app.add_option(
+      "dnx", dnx_specs,
+      "Compiled neural network artifacts (.dnx). Several artifacts of the "
+      "same network, compiled with different --optimize-for targets, are "
+      "embedded as variants, which are selected by the actual extents. "
+      "Variants name their target, e.g. net-hd.dnx@H=1080,W=1920. A "
+      "cooperative matrix variant and its portable fallback are selected "
+      "by the device features and need no target"));
 
   // Required output directories
-  app.add_option("--src-dir", src_dir_str,
-                 "Output directory for generated C source files")
-      ->required();
+  required_options.push_back(
+      app.add_option("--src-dir", src_dir_str,
+                     "Output directory for generated C source files"));
 
-  app.add_option("--shader-dir", shader_dir_str,
-                 "Output directory for generated shader sources")
-      ->required();
+  required_options.push_back(
+      app.add_option("--shader-dir", shader_dir_str,
+                     "Output directory for generated shader sources"));
 
-  app.add_option("--weight-dir", weight_dir_str,
-                 "Output directory for neural network weights")
-      ->required();
+  required_options.push_back(
+      app.add_option("--weight-dir", weight_dir_str,
+                     "Output directory for neural network weights"));
 
   app.add_option("--bin-dir", bin_dir_str, "vkdt binary directory");
 
-  app.add_option("--module-name", module_name, "Name of the vkdt module")
-      ->required();
+  required_options.push_back(app.add_option("--module-name", module_name,
+                                            "Name of the vkdt module"));
 
   // Directory creation flag
   app.add_flag(
-      "-p,--mkdir", mkdir,
+      "-p,--mkdir", options.mkdir,
       "Create output directories (including parents) if they do not exist");
 
-  CLI11_PARSE(app, argc, argv);
+  app.add_flag("--fold-push-constants", options.fold_push_constants,
+               "Specialize shaders for literal push constants, such that the "
+               "driver can constant fold them");
 
-  // ---- Filesystem validation ----
+  app.add_option("--fold-budget", options.fold_budget,
+                 "Maximum number of SPIR-V bytes, which shader variants of "
+                 "--fold-push-constants may add (default: 1MiB)");
 
-  const fs::path dnx_path{dnx_path_str};
-  const fs::path src_dir{src_dir_str};
-  const fs::path shader_dir{shader_dir_str};
-  const fs::path weight_dir{weight_dir_str};
-  const fs::path bin_dir{bin_dir_str};
+  app.add_flag("--strip-shaders", options.strip_shaders,
+               "Strip debug and reflection-only instructions as well as "
+               "unused types and constants from all shaders");
 
-  if (!fs::exists(dnx_path) || !fs::is_regular_file(dnx_path)) {
-    std::cerr << "Error: DNX artifact does not exist or is not a regular file: "
-              << dnx_path << '\n';
-    return 1;
-  }
+  app.add_flag("--merge-bindings", options.merge_bindings,
+               "Bind tensors, which a dispatch reads from the same buffer, "
+               "through a single connector and pass their offsets as push "
+               "constants");
 
-  auto check_output_dir = [&](const fs::path &dir, const char *name) -> bool {
-    if (fs::exists(dir)) {
-      if (!fs::is_directory(dir)) {
-        std::cerr << "Error: " << name
-                  << " exists but is not a directory: " << dir << '\n';
-        return false;
-      }
-      return true;
-    }
+  app.add_option("--max-workgroup-count", options.max_workgroup_count,
+                 "Per dimension workgroup count limit of the device. Larger "
+                 "x workgroup counts are folded into the z dimension "
+                 "(e.g. 65535, default: unlimited)")
+      ->check(CLI::PositiveNumber);
 
-    if (!mkdir) {
-      std::cerr << "Error: " << name << " does not exist: " << dir << '\n'
-                << "       Use --mkdir (-p) to create it.\n";
-      return false;
-    }
+  app.add_option("--extent-buckets", extent_buckets_str,
+                 "Round dynamic extents up to buckets when allocating "
+                 "intermediate buffers, such that small resolution changes "
+                 "do not reallocate the graph. Either multiple:<n> "
+                 "(e.g. multiple:256) or geometric:<growth> "
+                 "(e.g. geometric:1.25)");
 
-    std::error_code ec;
-    if (!fs::create_directories(dir, ec)) {
-      std::cerr << "Error: failed to create directory " << dir << ": "
-                << ec.message() << '\n';
-      return false;
-    }
+  app.add_option("--preprocessing", options.preprocessing,
+                 "Compute shader (.comp), which converts the input image of "
+                 "the module into every model input. Its push constants are "
+                 "uint width, height, channels and layout "
+                 "(0: HWC, 1: CHW, 2: CHWC8) of the tensor")
+      ->check(CLI::ExistingFile);
 
-    return true;
-  };
+  app.add_option("--post-processing", options.postprocessing,
+                 "Compute shader (.comp), which converts every model output "
+                 "into the output image of the module, with the push "
+                 "constants of --preprocessing")
+      ->check(CLI::ExistingFile);
 
-  if (!check_output_dir(src_dir_str, "src-dir") ||
-      !check_output_dir(shader_dir_str, "shader-dir") ||
-      !check_output_dir(weight_dir_str, "weight-dir") ||
-      !check_output_dir(bin_dir_str, "bin-dir")) {
-    return 1;
-  }
+  app.add_flag("--convert-layouts", options.convert_layouts,
+               "Generate processing stages, which convert between rgba images "
+               "and the layout of every model input and output, that has no "
+               "--preprocessing or --post-processing stage");
 
-  // Load dnx
-  std::vector<uint8_t> dnx_buffer = vkdt_denox::read_file_bytes(dnx_path_str);
-  const auto *dnx = denox::dnx::GetModel(dnx_buffer.data());
+  app.add_option("--hash-manifest", hash_manifest_str,
+                 "File recording the content hashes of the generated files, "
+                 "such that unchanged outputs are detected without rereading "
+                 "them. Unchanged files are never rewritten");
 
-  // Preprocessing for codegeneration
-  vkdt_denox::SymbolicIR symbolic_ir = vkdt_denox::read_symbolic_ir(dnx);
+  app.add_option("--jobs,-j", jobs,
+                 "Number of threads for the independent stages of the "
+                 "codegen and the output files (default: 1)")
+      ->check(CLI::PositiveNumber);
 
-  vkdt_denox::CompressedWeights compressed_weights =
-      vkdt_denox::compress_weights(dnx);
-  vkdt_denox::ShaderRegistry shader_registry =
-      vkdt_denox::create_shader_registry(dnx);
-  vkdt_denox::ComputeGraph compute_graph =
-      vkdt_denox::reconstruct_compute_graph(dnx, compressed_weights);
+  static constexpr const char *verify_description =
+      "Verify the structure of the .dnx artifacts before using them";
+  app.add_flag("--verify", verify_dnx, verify_description);
 
-  fs::path weight_path =
-      weight_dir / fmt::format("{}-weights.dat", module_name);
-  std::string weight_path_str = weight_path.string();
-  std::string rel_weight_path_str = fs::relative(weight_path, bin_dir).string();
-  fmt::println("relative-path: {}", rel_weight_path_str);
+  std::string cost_dnx_path_str;
+  std::vector<std::string> cost_defines;
+  CLI::App *cost = app.add_subcommand(
+      "cost", "Evaluate workgroup counts and memory traffic of every dispatch "
+              "for concrete extents");
+  cost->add_option("dnx", cost_dnx_path_str,
+                   "Compiled neural network artifact (.dnx)")
+      ->required()
+      ->check(CLI::ExistingFile);
+  cost->add_option("-D,--define", cost_defines,
+                   "Value of a symbolic extent, e.g. -D H=1080 -D W=1920");
+  cost->add_flag("--verify", verify_dnx, verify_description);
 
-  vkdt_denox::write_file_bytes(weight_path_str, compressed_weights.data.data(),
-                               compressed_weights.data.size());
+  std::string lint_dnx_path_str;
+  std::vector<std::string> lint_resolutions;
+  vkdt_denox::LintOptions lint_options;
+  std::string lint_output_str;
+  bool lint_strict = false;
+  CLI::App *lint = app.add_subcommand(
+      "lint", "Report dispatches, weights and connectors, which make the "
+              "generated module slower than necessary, as JSON");
+  lint->add_option("dnx", lint_dnx_path_str,
+                   "Compiled neural network artifact (.dnx)")
+      ->required()
+      ->check(CLI::ExistingFile);
+  lint->add_option("--at", lint_resolutions,
+                   "Extents of a resolution to evaluate, e.g. "
+                   "--at H=1080,W=1920 --at H=540,W=960")
+      ->required();
+  lint->add_option("--min-workgroups", lint_options.min_workgroups,
+                   "Workgroups a dispatch needs to fill the GPU "
+                   "(default: 256)");
+  lint->add_option("--max-padding", lint_options.max_padding_ratio,
+                   "Share of the weight file, which alignment padding may "
+                   "take (default: 0.05)");
+  lint->add_option("-o,--output", lint_output_str,
+                   "Write the report to a file instead of stdout");
+  lint->add_flag("--strict", lint_strict,
+                 "Exit with status 2 if anything is reported, e.g. to gate "
+                 "model exports");
+  lint->add_flag("--verify", verify_dnx, verify_description);
 
-  for (const auto &binary : shader_registry.binaries) {
-    fs::path path = shader_dir / (binary.name + ".comp.spv");
-    vkdt_denox::write_file_bytes(path, binary.spv.data(),
-                                 binary.spv.size() * sizeof(uint32_t));
+  std::string batch_manifest_str;
+  std::string shared_shader_module;
+  std::string shared_shader_dir_str;
+  CLI::App *batch = app.add_subcommand(
+      "batch", "Generate several modules in one process, the options of "
+               "vkdt-denox apply to all of them");
+  batch->fallthrough();
+  batch
+      ->add_option("manifest", batch_manifest_str,
+                   "One module per line: module=<name> src=<dir> "
+                   "shaders=<dir> weights=<dir> bin=<dir> dnx=<path> "
+                   "[dnx=<path>...]")
+      ->required()
+      ->check(CLI::ExistingFile);
+  batch->add_option("--shared-shader-module", shared_shader_module,
+                    "vkdt module, which holds the kernels of all modules. "
+                    "Identical kernels are written and loaded once");
+  batch->add_option("--shared-shader-dir", shared_shader_dir_str,
+                    "Shader directory of --shared-shader-module");
+
+  CLI11_PARSE(app, argc, argv);
+
+  if (cost->parsed()) {
+    return print_dispatch_costs(cost_dnx_path_str, cost_defines, verify_dnx);
+  }
+  if (lint->parsed()) {
+    return lint_dnx(lint_dnx_path_str, lint_resolutions, lint_options,
+                    lint_output_str, lint_strict, verify_dnx);
   }
 
-  vkdt_denox::SourceWriter src;
-  src.add_header_guard(fmt::format("{}_DENOX_MODULE_H", module_name));
-  src.append("\n");
-  vkdt_denox::def_func_denox_read_source(src, compute_graph, compressed_weights,
-                                         rel_weight_path_str, module_name);
+  if (!extent_buckets_str.empty()) {
+    auto buckets = parse_extent_buckets(extent_buckets_str);
+    if (!buckets.has_value()) {
+      std::cerr << "Error: invalid --extent-buckets " << extent_buckets_str
+                << ", expected multiple:<n> or geometric:<growth>\n";
+      return 1;
+    }
+    options.extent_buckets = *buckets;
+  }
 
-  src.append("\n");
-  vkdt_denox::def_func_denox_create_nodes(src, dnx, symbolic_ir,
-                                          shader_registry, compressed_weights,
-                                          compute_graph, module_name);
-  src.append("\n");
+  const std::optional<fs::path> hash_manifest =
+      hash_manifest_str.empty() ? std::nullopt
+                                : std::optional<fs::path>(hash_manifest_str);
+
+  if (batch->parsed()) {
+    if (shared_shader_module.empty() != shared_shader_dir_str.empty()) {
+      std::cerr << "Error: --shared-shader-module and --shared-shader-dir "
+                   "are only valid together\n";
+      return 1;
+    }
+    return run_batch(batch_manifest_str, options, jobs, verify_dnx,
+                     hash_manifest, shared_shader_module,
+                     shared_shader_dir_str);
+  }
+  for (const auto *option : required_options) {
+    if (option->count() == 0) {
+      std::cerr << "Error: " << option->get_name() << " is required\n";
+      return 1;
+    }
+  }
+
+  const ModuleSpec spec{
+      .module_name = module_name,
+      .dnx_specs = dnx_specs,
+      .src_dir = src_dir_str,
+      .shader_dir = shader_dir_str,
+      .weight_dir = weight_dir_str,
+      .bin_dir = bin_dir_str,
+  };
+
+  // Generated files are only written if their content changed.
+  vkdt_denox::OutputWriter output_writer(hash_manifest);
+  vkdt_denox::TaskPool task_pool(jobs);
+  DnxCache dnx_cache(verify_dnx);
+
+  std::optional<PreparedModule> module =
+      prepare_module(spec, options, dnx_cache, output_writer, task_pool);
+  if (!module.has_value()) {
+    return 1;
+  }
+  emit_module(*module, module->shader_registry, options, output_writer,
+              task_pool);
 
-  fs::path src_path = src_dir / "denox_model.h";
-  vkdt_denox::write_file(src_path, src.finish());
+  output_writer.finish();
+  fmt::println("wrote {} files, {} unchanged", output_writer.written(),
+               output_writer.unchanged());
   return 0;
 }
@@ -2,17 +2,72 @@
 #include "symbolics.hpp"
 #include "util.hpp"
 #include <algorithm>
+#include <cstring>
 #include <dnx.h>
-#include <fmt/base.h>
-#include <iostream>
-#include <limits>
-#include <memory>
 #include <stdexcept>
+#include <unordered_map>
+
+static void check_initalized_tensor(const denox::dnx::Tensor *tensor) {
+  if (tensor->offset_type() == denox::dnx::ScalarSource_symbolic) {
+    throw std::runtime_error(
+        "Unexpected tensor offset. vkdt_denox assumes that tensor "
+        "intializers reference tensors with a compiletime offset, "
+        "encountered symbolic expression. Operation not supported!");
+  }
+  uint64_t tensor_offset =
+      vkdt_denox::read_unsigned_scalar_literal(tensor->offset_as_literal());
+  if (tensor_offset != 0) {
+    throw std::runtime_error(
+        "Unexpected tensor offset. vkdt_denox assumes that TensorInitalizers "
+        "initalize full buffers, encountered partial initalization of a "
+        "buffer, which is currently not implemented!");
+  }
+}
+
+namespace vkdt_denox {
+
+namespace {
+
+struct SharedInitializer {
+  const uint8_t *bytes;
+  size_t size;
+  size_t alignment;
+  size_t model;
+  uint32_t tensor_id;
+  uint64_t hash;
+};
+
+struct StoredInitializer {
+  size_t offset;
+  const uint8_t *bytes;
+  size_t size;
+};
+
+} // namespace
+
+// Padding between initializers is borrowed from here, larger gaps are
+// split into several chunks.
+static constexpr size_t WEIGHT_PADDING_SIZE = 4096;
+static constexpr uint8_t WEIGHT_PADDING[WEIGHT_PADDING_SIZE] = {};
+
+static void append_padding(std::vector<std::span<const uint8_t>> &chunks,
+                           size_t size) {
+  while (size != 0) {
+    const size_t n = std::min(size, WEIGHT_PADDING_SIZE);
+    chunks.emplace_back(WEIGHT_PADDING, n);
+    size -= n;
+  }
+}
+
+} // namespace vkdt_denox
 
 vkdt_denox::CompressedWeights
 vkdt_denox::compress_weights(const denox::dnx::Model *dnx) {
   const auto *initalizers = dnx->initializers();
 
+  CompressedWeights compressed_weights;
+  compressed_weights.offsets.resize(dnx->tensors()->size(), -1);
+
   size_t offset = 0;
   const uint32_t initalizer_count = initalizers->size();
   for (uint32_t i = 0; i < initalizer_count; ++i) {
@@ -22,45 +77,124 @@ vkdt_denox::compress_weights(const denox::dnx::Model *dnx) {
     const uint32_t buffer_id = tensor->buffer();
     const auto *buffer = dnx->buffers()->Get(buffer_id);
 
-    if (tensor->offset_type() == denox::dnx::ScalarSource_symbolic) {
-      throw std::runtime_error(
-          "Unexpected tensor offset. vkdt_denox assumes that tensor "
-          "intializers reference tensors with a compiletime offset, "
-          "encountered symbolic expression. Operation not supported!");
+    check_initalized_tensor(tensor);
+
+    const size_t alignment = buffer->alignment();
+
+    const size_t aligned = align_up(offset, alignment);
+    append_padding(compressed_weights.chunks, aligned - offset);
+    compressed_weights.padding_bytes += aligned - offset;
+    compressed_weights.chunks.emplace_back(initalizer->data()->data(),
+                                           initalizer->data()->size());
+    compressed_weights.offsets[tensor_id] = aligned;
+    offset = aligned + initalizer->data()->size();
+  }
+  compressed_weights.byte_size = offset;
+  return compressed_weights;
+}
+
+bool vkdt_denox::equal_weights(const CompressedWeights &lhs,
+                               const CompressedWeights &rhs) {
+  if (lhs.byte_size != rhs.byte_size) {
+    return false;
+  }
+  // Chunk boundaries of both files may differ.
+  auto l = lhs.chunks.begin();
+  auto r = rhs.chunks.begin();
+  size_t l_offset = 0;
+  size_t r_offset = 0;
+  while (l != lhs.chunks.end() && r != rhs.chunks.end()) {
+    const size_t n = std::min(l->size() - l_offset, r->size() - r_offset);
+    if (n != 0 && l->data() + l_offset != r->data() + r_offset &&
+        std::memcmp(l->data() + l_offset, r->data() + r_offset, n) != 0) {
+      return false;
+    }
+    l_offset += n;
+    r_offset += n;
+    if (l_offset == l->size()) {
+      ++l;
+      l_offset = 0;
     }
-    uint64_t tensor_offset =
-        vkdt_denox::read_unsigned_scalar_literal(tensor->offset_as_literal());
-    if (tensor_offset != 0) {
-      throw std::runtime_error(
-          "Unexpected tensor offset. vkdt_denox assumes that TensorInitalizers "
-          "initalize full buffers, encountered partial initalization of a "
-          "buffer, which is currently not implemented!");
+    if (r_offset == r->size()) {
+      ++r;
+      r_offset = 0;
     }
+  }
+  return true;
+}
 
-    const size_t alignment = buffer->alignment();
+std::vector<vkdt_denox::CompressedWeights> vkdt_denox::compress_shared_weights(
+    std::span<const denox::dnx::Model *const> models, TaskPool *task_pool) {
+  std::vector<CompressedWeights> compressed(models.size());
+  std::vector<SharedInitializer> initializers;
+  for (std::size_t m = 0; m < models.size(); ++m) {
+    const auto *dnx = models[m];
+    compressed[m].offsets.resize(dnx->tensors()->size(), -1);
 
-    offset = align_up(offset, alignment);
-    offset += initalizer->data()->size();
+    const auto *initalizers = dnx->initializers();
+    for (uint32_t i = 0; i < initalizers->size(); ++i) {
+      const auto *initalizer = initalizers->Get(i);
+      const uint32_t tensor_id = initalizer->tensor();
+      const auto *tensor = dnx->tensors()->Get(tensor_id);
+      check_initalized_tensor(tensor);
+      const auto *buffer = dnx->buffers()->Get(tensor->buffer());
+      initializers.push_back(SharedInitializer{
+          .bytes = initalizer->data()->data(),
+          .size = initalizer->data()->size(),
+          .alignment = buffer->alignment(),
+          .model = m,
+          .tensor_id = tensor_id,
+          .hash = 0,
+      });
+    }
   }
-  const size_t byte_size = offset;
-  CompressedWeights compressed_weights;
-  compressed_weights.offsets.resize(dnx->tensors()->size(), -1);
-  compressed_weights.data.resize(byte_size, 0); // <- initalize all to zero!
 
-  offset = 0;
-  for (uint32_t i = 0; i < initalizer_count; ++i) {
-    const auto *initalizer = initalizers->Get(i);
-    const uint32_t tensor_id = initalizer->tensor();
-    const auto *tensor = dnx->tensors()->Get(tensor_id);
-    const uint32_t buffer_id = tensor->buffer();
-    const auto *buffer = dnx->buffers()->Get(buffer_id);
-    const size_t alignment = buffer->alignment();
+  auto hash_initializer = [&](size_t i) {
+    initializers[i].hash = fnv1a64(initializers[i].bytes, initializers[i].size);
+  };
+  if (task_pool != nullptr) {
+    task_pool->parallel_for(initializers.size(), hash_initializer);
+  } else {
+    for (size_t i = 0; i < initializers.size(); ++i) {
+      hash_initializer(i);
+    }
+  }
 
-    offset = align_up(offset, alignment);
-    std::memcpy(compressed_weights.data.data() + offset,
-                initalizer->data()->data(), initalizer->data()->size());
-    compressed_weights.offsets[tensor_id] = offset;
-    offset += initalizer->data()->size();
+  // Maps content hashes to the already stored initializers.
+  std::unordered_map<uint64_t, std::vector<StoredInitializer>> stored;
+  std::vector<std::span<const uint8_t>> chunks;
+  size_t byte_size = 0;
+  size_t padding_bytes = 0;
+  for (const auto &initializer : initializers) {
+    auto &candidates = stored[initializer.hash];
+    auto it =
+        std::ranges::find_if(candidates, [&](const StoredInitializer &other) {
+          return other.offset % initializer.alignment == 0 &&
+                 other.size == initializer.size &&
+                 std::memcmp(other.bytes, initializer.bytes, other.size) == 0;
+        });
+    size_t offset;
+    if (it != candidates.end()) {
+      offset = it->offset;
+    } else {
+      offset = align_up(byte_size, initializer.alignment);
+      append_padding(chunks, offset - byte_size);
+      padding_bytes += offset - byte_size;
+      chunks.emplace_back(initializer.bytes, initializer.size);
+      byte_size = offset + initializer.size;
+      candidates.push_back(StoredInitializer{
+          .offset = offset,
+          .bytes = initializer.bytes,
+          .size = initializer.size,
+      });
+    }
+    compressed[initializer.model].offsets[initializer.tensor_id] = offset;
   }
-  return compressed_weights;
+
+  for (auto &weights : compressed) {
+    weights.byte_size = byte_size;
+    weights.padding_bytes = padding_bytes;
+    weights.chunks = chunks;
+  }
+  return compressed;
 }
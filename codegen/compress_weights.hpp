@@ -1,7 +1,10 @@
 #pragma once
 
+#include "task_pool.hpp"
 #include <cstddef>
 #include <dnx.h>
+#include <span>
+#include <vector>
 namespace vkdt_denox {
 
 struct CompressedWeights {
@@ -9,9 +12,27 @@ struct CompressedWeights {
   // if offsets[tensor-id] == -1, then this tensor is not a weight!
   // Otherwise gives aligned offset of the tensor-id.
   std::vector<int64_t> offsets;
-  std::vector<uint8_t> data;
+  // Byte size of the weight file.
+  std::size_t byte_size = 0;
+  // Zero bytes between the initializers, which align them.
+  std::size_t padding_bytes = 0;
+  // Content of the weight file in file order, the initializers and the zero
+  // padding between them. The weights are never copied, the initializers are
+  // borrowed from the dnx, which has to outlive the compressed weights.
+  std::vector<std::span<const uint8_t>> chunks;
 };
 
 CompressedWeights compress_weights(const denox::dnx::Model *model);
 
+/// Whether both weight files have the same content.
+bool equal_weights(const CompressedWeights &lhs, const CompressedWeights &rhs);
+
+/// Compresses the weights of several models, which are uploaded from a single
+/// weight file. Byte-identical initializers are stored once. The result holds
+/// one entry per model, all with the same chunks. With a task pool the
+/// initializers are hashed in parallel.
+std::vector<CompressedWeights>
+compress_shared_weights(std::span<const denox::dnx::Model *const> models,
+                        TaskPool *task_pool = nullptr);
+
 } // namespace vkdt_denox
@@ -19,7 +19,8 @@ static size_t sizeof_format(vkdt_denox::SinkSourceFormat format) {
 }
 
 vkdt_denox::ComputeGraph vkdt_denox::reconstruct_compute_graph(
-    const denox::dnx::Model *dnx, const CompressedWeights &compressed_weights) {
+    const denox::dnx::Model *dnx, const CompressedWeights &compressed_weights,
+    const ShaderRegistry &shader_registry) {
   const uint32_t buffer_count = dnx->buffers()->size();
   const uint32_t tensor_count = dnx->tensors()->size();
   const uint32_t dispatch_count = dnx->dispatches()->size();
@@ -47,7 +48,7 @@ vkdt_denox::ComputeGraph vkdt_denox::reconstruct_compute_graph(
   ComputeGraph graph;
   uint32_t weight_buffer_roi_id = graph.buffer_rois.size();
   graph.buffer_rois.push_back(BufferRoi{
-      .byte_size = compressed_weights.data.size(),
+      .byte_size = compressed_weights.byte_size,
       .format = SinkSourceFormat::Byte,
   });
   size_t weight_node_id = graph.nodes.size();
@@ -395,7 +396,15 @@ vkdt_denox::ComputeGraph vkdt_denox::reconstruct_compute_graph(
       node_compute_dispatch.name = fmt::format("unnamed_dispatch_{}", d);
     }
 
-    node_compute_dispatch.binary_id = compute_dispatch->binary_id();
+    // refer to the deduplicated binary of the shader registry.
+    node_compute_dispatch.binary_id = shader_registry.dispatch_binary_ids[d];
+    if (compute_dispatch->entry_point() != nullptr &&
+        compute_dispatch->entry_point()->size() != 0) {
+      node_compute_dispatch.entry_point =
+          compute_dispatch->entry_point()->str();
+    } else {
+      node_compute_dispatch.entry_point = "main";
+    }
     node_compute_dispatch.workgroup_count_x = Symbol{
         .type = compute_dispatch->workgroup_count_x_type(),
         .ptr = compute_dispatch->workgroup_count_x(),
@@ -546,6 +555,8 @@ vkdt_denox::ComputeGraph vkdt_denox::reconstruct_compute_graph(
     graph.input_descriptors[i].format = format;
     graph.input_descriptors[i].chan = chan;
     graph.input_descriptors[i].layout = layout;
+    graph.input_descriptors[i].buffer_roi_id = location.buffer_roi_id;
+    graph.input_descriptors[i].tensor_info = tensor_info;
   }
 
   graph.output_descriptors.resize(output_count);
@@ -615,6 +626,8 @@ vkdt_denox::ComputeGraph vkdt_denox::reconstruct_compute_graph(
     graph.output_descriptors[o].format = format;
     graph.output_descriptors[o].chan = chan;
     graph.output_descriptors[o].layout = layout;
+    graph.output_descriptors[o].buffer_roi_id = location.buffer_roi_id;
+    graph.output_descriptors[o].tensor_info = tensor_info;
 
     // update format of owning nodes sinksource
     graph.nodes[location.owning_node]
@@ -662,3 +675,37 @@ vkdt_denox::ComputeGraph vkdt_denox::reconstruct_compute_graph(
 
   return graph;
 }
+
+bool vkdt_denox::is_contiguous_u32(const PushConstants &pc) {
+  std::vector<uint16_t> offsets;
+  for (const auto &field : pc.fields) {
+    if (field.type != PushConstantType::U32) {
+      return false;
+    }
+    offsets.push_back(field.offset);
+  }
+  std::ranges::sort(offsets);
+  for (std::size_t i = 0; i < offsets.size(); ++i) {
+    if (offsets[i] != i * sizeof(uint32_t)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<bool>
+vkdt_denox::external_buffer_rois(const ComputeGraph &compute_graph) {
+  std::vector<bool> external(compute_graph.buffer_rois.size(), false);
+  for (const auto &connector : compute_graph.connectors) {
+    if (connector.src_node == external_sential) {
+      const auto &node = compute_graph.nodes[connector.dst_node];
+      external[node.sinksources[connector.dst_node_sinksource].buffer_roi_id] =
+          true;
+    } else if (connector.dst_node == external_sential) {
+      const auto &node = compute_graph.nodes[connector.src_node];
+      external[node.sinksources[connector.src_node_sinksource].buffer_roi_id] =
+          true;
+    }
+  }
+  return external;
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "compress_weights.hpp"
+#include "shader_registry.hpp"
 #include "symbolics.hpp"
 #include <cstdint>
 #include <dnx.h>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
@@ -53,6 +55,8 @@ struct PushConstantField {
   uint16_t offset;
   PushConstantType type;
   Symbol value;
+  // Constant added to the value, e.g. the byte offset of a merged binding.
+  uint64_t addend = 0;
 };
 
 struct PushConstants {
@@ -63,9 +67,15 @@ struct PushConstants {
 struct ComputeDispatch {
   std::string name;
   uint32_t binary_id;
+  // Entry point requested by the dnx, the binary itself always exposes it as
+  // "main".
+  std::string entry_point;
   Symbol workgroup_count_x;
   Symbol workgroup_count_y;
   Symbol workgroup_count_z;
+  // Set by split_oversized_dispatches, x workgroups beyond the limit are
+  // folded into the z dimension.
+  std::optional<uint32_t> workgroup_limit;
   PushConstants pc;
   const denox::dnx::DispatchInfo* info;
 };
@@ -107,6 +117,11 @@ struct InOutDescriptor {
   SinkSourceChan chan;
   SinkSourceFormat format;
   InOutLayout layout;
+  uint32_t buffer_roi_id;
+  const denox::dnx::TensorInfo *tensor_info;
+  // vkdt kernel, which converts between the module connector and the tensor
+  // (e.g. --preprocessing), the connector is wired to the tensor otherwise.
+  std::optional<std::string> stage_kernel;
 };
 
 struct ComputeGraph {
@@ -122,6 +137,16 @@ struct ComputeGraph {
 
 ComputeGraph
 reconstruct_compute_graph(const denox::dnx::Model *dnx,
-                          const CompressedWeights &compressed_weights);
+                          const CompressedWeights &compressed_weights,
+                          const ShaderRegistry &shader_registry);
+
+/// Whether the push constants are consecutive uint32_t values from offset 0,
+/// which the generated code initializes as an array instead of memcpy'ing
+/// every field.
+bool is_contiguous_u32(const PushConstants &pc);
+
+/// Buffer rois connected to the module, which have to match the extents of
+/// the module connectors exactly.
+std::vector<bool> external_buffer_rois(const ComputeGraph &compute_graph);
 
 } // namespace vkdt_denox
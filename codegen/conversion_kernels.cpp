@@ -0,0 +1,179 @@
+#include "conversion_kernels.hpp"
+#include "source_writer.hpp"
+#include <stdexcept>
+
+namespace vkdt_denox {
+
+// Push constants and workgroup size of processing stages, see
+// create_stage_node in denox_create_nodes.cpp.
+static constexpr const char *conversion_preamble = R"(#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_shader_16bit_storage : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : enable
+#include "shared.glsl"
+
+layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z = 1) in;
+
+layout(std140, push_constant) uniform push_t {
+  uint width;
+  uint height;
+  uint channels;
+  uint tensor_layout; // 0: HWC, 1: CHW, 2: CHWC8
+} push;
+)";
+
+static std::string_view conversion_kernel_name(InOutLayout layout,
+                                               SinkSourceType type) {
+  const bool input = type == SinkSourceType::Read;
+  switch (layout) {
+  case InOutLayout::HWC:
+    return input ? "img2hwc" : "hwc2img";
+  case InOutLayout::CHW:
+    return input ? "img2chw" : "chw2img";
+  case InOutLayout::CHWC8:
+    return input ? "img2c8" : "c82img";
+  }
+  throw std::runtime_error("unreachable");
+}
+
+/// rgba image -> tensor
+static void image_to_tensor(SourceWriter &src, InOutLayout layout) {
+  src.append("layout(set = 1, binding = 0) uniform sampler2D img_in;");
+  switch (layout) {
+  case InOutLayout::HWC:
+    // Four channel tensors are written with a single f16x4 store.
+    src.append("layout(set = 1, binding = 1) writeonly buffer ssbo_out_t "
+               "{ float16_t v[]; } ssbo_out;");
+    src.append("layout(set = 1, binding = 1) writeonly buffer ssbo_out4_t "
+               "{ f16vec4 v[]; } ssbo_out4;");
+    break;
+  case InOutLayout::CHW:
+    src.append("layout(set = 1, binding = 1) writeonly buffer ssbo_out_t "
+               "{ float16_t v[]; } ssbo_out;");
+    break;
+  case InOutLayout::CHWC8:
+    // A channel group of 8 x f16 is written as one 16 byte store.
+    src.append("layout(set = 1, binding = 1) writeonly buffer ssbo_out8_t "
+               "{ uvec4 v[]; } ssbo_out8;");
+    break;
+  }
+  src.append("\n");
+  src.append(R"(void main() {
+  const ivec2 ipos = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(ipos, ivec2(push.width, push.height)))) return;
+  const f16vec4 rgba = f16vec4(texelFetch(img_in, ipos, 0));
+  const uint pixel = ipos.y * push.width + ipos.x;)");
+  src.push_indentation();
+  switch (layout) {
+  case InOutLayout::HWC:
+    src.append(R"(if (push.channels == 4) {
+  ssbo_out4.v[pixel] = rgba;
+  return;
+}
+for (uint c = 0; c < push.channels; ++c) {
+  ssbo_out.v[pixel * push.channels + c] = c < 4 ? rgba[c] : float16_t(0);
+})");
+    break;
+  case InOutLayout::CHW:
+    src.append(R"(const uint plane = push.width * push.height;
+for (uint c = 0; c < push.channels; ++c) {
+  ssbo_out.v[c * plane + pixel] = c < 4 ? rgba[c] : float16_t(0);
+})");
+    break;
+  case InOutLayout::CHWC8:
+    src.append(R"(const uint plane = push.width * push.height;
+f16vec4 lo = f16vec4(0);
+for (uint c = 0; c < min(push.channels, 4u); ++c) {
+  lo[c] = rgba[c];
+}
+ssbo_out8.v[pixel] = uvec4(packFloat2x16(lo.xy), packFloat2x16(lo.zw), 0, 0);
+// channels beyond rgba and the padding of the last group are zero.
+for (uint g = 1; g < (push.channels + 7) / 8; ++g) {
+  ssbo_out8.v[g * plane + pixel] = uvec4(0);
+})");
+    break;
+  }
+  src.pop_indentation();
+  src.append("}");
+}
+
+/// tensor -> rgba image
+static void tensor_to_image(SourceWriter &src, InOutLayout layout) {
+  switch (layout) {
+  case InOutLayout::HWC:
+    // Four channel tensors are read with a single f16x4 load.
+    src.append("layout(set = 1, binding = 0) readonly buffer ssbo_in_t "
+               "{ float16_t v[]; } ssbo_in;");
+    src.append("layout(set = 1, binding = 0) readonly buffer ssbo_in4_t "
+               "{ f16vec4 v[]; } ssbo_in4;");
+    break;
+  case InOutLayout::CHW:
+    src.append("layout(set = 1, binding = 0) readonly buffer ssbo_in_t "
+               "{ float16_t v[]; } ssbo_in;");
+    break;
+  case InOutLayout::CHWC8:
+    // A channel group of 8 x f16 is read as one 16 byte load.
+    src.append("layout(set = 1, binding = 0) readonly buffer ssbo_in8_t "
+               "{ uvec4 v[]; } ssbo_in8;");
+    break;
+  }
+  src.append("layout(set = 1, binding = 1) uniform writeonly image2D img_out;");
+  src.append("\n");
+  src.append(R"(void main() {
+  const ivec2 ipos = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(ipos, ivec2(push.width, push.height)))) return;
+  const uint pixel = ipos.y * push.width + ipos.x;
+  f16vec4 rgba = f16vec4(0, 0, 0, 1);)");
+  src.push_indentation();
+  switch (layout) {
+  case InOutLayout::HWC:
+    src.append(R"(if (push.channels == 4) {
+  rgba = ssbo_in4.v[pixel];
+} else {
+  for (uint c = 0; c < min(push.channels, 4u); ++c) {
+    rgba[c] = ssbo_in.v[pixel * push.channels + c];
+  }
+})");
+    break;
+  case InOutLayout::CHW:
+    src.append(R"(const uint plane = push.width * push.height;
+for (uint c = 0; c < min(push.channels, 4u); ++c) {
+  rgba[c] = ssbo_in.v[c * plane + pixel];
+})");
+    break;
+  case InOutLayout::CHWC8:
+    src.append(R"(const uvec4 group = ssbo_in8.v[pixel];
+const f16vec4 lo = f16vec4(unpackFloat2x16(group.x), unpackFloat2x16(group.y));
+for (uint c = 0; c < min(push.channels, 4u); ++c) {
+  rgba[c] = lo[c];
+})");
+    break;
+  }
+  // single channel outputs (e.g. masks) are shown as grey.
+  src.append(R"(if (push.channels == 1) {
+  rgba.gb = rgba.rr;
+}
+imageStore(img_out, ipos, vec4(rgba));)");
+  src.pop_indentation();
+  src.append("}");
+}
+
+} // namespace vkdt_denox
+
+vkdt_denox::ConversionKernel
+vkdt_denox::create_conversion_kernel(InOutLayout layout, SinkSourceType type) {
+  SourceWriter src;
+  src.append(conversion_preamble);
+  src.append("\n");
+  if (type == SinkSourceType::Read) {
+    image_to_tensor(src, layout);
+  } else if (type == SinkSourceType::Write) {
+    tensor_to_image(src, layout);
+  } else {
+    throw std::runtime_error("conversion kernels require an input or output.");
+  }
+  return ConversionKernel{
+      .name = std::string(conversion_kernel_name(layout, type)),
+      .source = src.finish(),
+  };
+}
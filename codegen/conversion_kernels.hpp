@@ -0,0 +1,21 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include <string>
+namespace vkdt_denox {
+
+/// GLSL source of a vkdt kernel (<name>.comp), which vkdt compiles with the
+/// module.
+struct ConversionKernel {
+  std::string name;
+  std::string source;
+};
+
+/// Creates a processing stage, which converts an rgba image into an input
+/// tensor (SinkSourceType::Read) or an output tensor into an rgba image
+/// (SinkSourceType::Write) of the given layout. Channels beyond rgba are zero,
+/// CHWC8 channel groups are zero padded.
+ConversionKernel create_conversion_kernel(InOutLayout layout,
+                                          SinkSourceType type);
+
+} // namespace vkdt_denox
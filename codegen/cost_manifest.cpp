@@ -0,0 +1,276 @@
+#include "cost_manifest.hpp"
+#include "source_writer.hpp"
+#include <dnx.h>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <variant>
+
+namespace vkdt_denox {
+
+std::string json_string(std::string_view str) {
+  std::string escaped = "\"";
+  for (char c : str) {
+    switch (c) {
+    case '"':
+      escaped.append("\\\"");
+      break;
+    case '\\':
+      escaped.append("\\\\");
+      break;
+    case '\n':
+      escaped.append("\\n");
+      break;
+    case '\t':
+      escaped.append("\\t");
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        escaped.append(fmt::format("\\u{:04x}", c));
+      } else {
+        escaped.push_back(c);
+      }
+      break;
+    }
+  }
+  escaped.push_back('"');
+  return escaped;
+}
+
+/// Name of a symbol within the generated C code.
+static std::string symbol_name(const SymbolicIR &ir, uint32_t sid) {
+  if (sid < ir.vars.size()) {
+    return ir.vars[sid];
+  }
+  return fmt::format("r{}", sid);
+}
+
+/// Literals become JSON numbers, symbolic values the name of the symbol.
+static std::string json_symbol(const SymbolicIR &ir, Symbol symbol) {
+  switch (symbol.type) {
+  case denox::dnx::ScalarSource_literal:
+    return fmt::format(
+        "{}", static_cast<int64_t>(read_unsigned_scalar_literal(
+                  static_cast<const denox::dnx::ScalarLiteral *>(symbol.ptr))));
+  case denox::dnx::ScalarSource_symbolic:
+    return json_string(symbol_name(
+        ir, static_cast<const denox::dnx::SymRef *>(symbol.ptr)->sid()));
+  default:
+    return "null";
+  }
+}
+
+static std::string_view symir_operation_name(uint16_t operation) {
+  switch (operation) {
+  case denox::dnx::SymIROpCode_ADD:
+    return "add";
+  case denox::dnx::SymIROpCode_SUB:
+    return "sub";
+  case denox::dnx::SymIROpCode_MUL:
+    return "mul";
+  case denox::dnx::SymIROpCode_DIV:
+    return "div";
+  case denox::dnx::SymIROpCode_MOD:
+    return "mod";
+  case denox::dnx::SymIROpCode_MIN:
+    return "min";
+  case denox::dnx::SymIROpCode_MAX:
+    return "max";
+  default:
+    return "nop";
+  }
+}
+
+static std::string_view push_constant_type_name(PushConstantType type) {
+  switch (type) {
+  case PushConstantType::U32:
+    return "u32";
+  case PushConstantType::I32:
+    return "i32";
+  case PushConstantType::U16:
+    return "u16";
+  case PushConstantType::I16:
+    return "i16";
+  case PushConstantType::U64:
+    return "u64";
+  case PushConstantType::I64:
+    return "i64";
+  }
+  throw std::runtime_error("unreachable");
+}
+
+static void write_symbols(SourceWriter &src, const SymbolicIR &ir) {
+  std::string vars = "\"variables\": [";
+  for (std::size_t i = 0; i < ir.vars.size(); ++i) {
+    vars.append(fmt::format("{}{}", i == 0 ? "" : ", ",
+                            json_string(ir.vars[i])));
+  }
+  vars.append("],");
+  src.append(vars);
+
+  src.append("\"symbols\": [");
+  src.push_indentation();
+  const uint32_t k = ir.vars.size();
+  const uint32_t m = ir.symir->ops()->size();
+  const auto mask =
+      ~denox::dnx::SymIROpCode_LHSC & ~denox::dnx::SymIROpCode_RHSC;
+  for (uint32_t i = 0; i < m; ++i) {
+    const auto *op = ir.symir->ops()->Get(i);
+    const auto opcode = op->opcode();
+    const std::string lhs =
+        (opcode & denox::dnx::SymIROpCode_LHSC)
+            ? fmt::format("{}", op->lhs())
+            : json_string(symbol_name(ir, static_cast<uint32_t>(op->lhs())));
+    const std::string rhs =
+        (opcode & denox::dnx::SymIROpCode_RHSC)
+            ? fmt::format("{}", op->rhs())
+            : json_string(symbol_name(ir, static_cast<uint32_t>(op->rhs())));
+    src.append(fmt::format(
+        "{{\"name\": {}, \"op\": \"{}\", \"lhs\": {}, \"rhs\": {}}}{}",
+        json_string(symbol_name(ir, k + i)),
+        symir_operation_name(opcode & mask), lhs, rhs, i + 1 == m ? "" : ","));
+  }
+  src.pop_indentation();
+  src.append("],");
+}
+
+static void write_dispatch(SourceWriter &src, const SymbolicIR &ir,
+                           const ComputeDispatch &dispatch,
+                           const ShaderRegistry &shader_registry) {
+  const auto *info = dispatch.info;
+  src.append("\"type\": \"dispatch\",");
+  src.append(fmt::format("\"node\": {},", json_string(dispatch.name)));
+  src.append(fmt::format(
+      "\"shader\": {},",
+      json_string(shader_registry.binaries[dispatch.binary_id].name)));
+  src.append(fmt::format("\"entry_point\": {},",
+                         json_string(dispatch.entry_point)));
+  if (info != nullptr && info->src_path() != nullptr) {
+    src.append(fmt::format("\"src_path\": {},",
+                           json_string(info->src_path()->str())));
+  }
+  if (info != nullptr && info->debug_info() != nullptr) {
+    src.append(fmt::format("\"debug_info\": {},",
+                           json_string(info->debug_info()->str())));
+  }
+  src.append(fmt::format("\"workgroup_count\": [{}, {}, {}],",
+                         json_symbol(ir, dispatch.workgroup_count_x),
+                         json_symbol(ir, dispatch.workgroup_count_y),
+                         json_symbol(ir, dispatch.workgroup_count_z)));
+  if (dispatch.workgroup_limit.has_value()) {
+    src.append(
+        fmt::format("\"workgroup_limit\": {},", *dispatch.workgroup_limit));
+  }
+
+  src.append("\"push_constants\": {");
+  src.push_indentation();
+  src.append(fmt::format("\"size\": {},", dispatch.pc.size));
+  src.append("\"fields\": [");
+  src.push_indentation();
+  for (std::size_t i = 0; i < dispatch.pc.fields.size(); ++i) {
+    const auto &field = dispatch.pc.fields[i];
+    const std::string addend =
+        field.addend == 0 ? ""
+                          : fmt::format(", \"addend\": {}", field.addend);
+    src.append(fmt::format(
+        "{{\"offset\": {}, \"type\": \"{}\", \"value\": {}{}}}{}",
+        field.offset, push_constant_type_name(field.type),
+        json_symbol(ir, field.value), addend,
+        i + 1 == dispatch.pc.fields.size() ? "" : ","));
+  }
+  src.pop_indentation();
+  src.append("]");
+  src.pop_indentation();
+  src.append("},");
+
+  if (info != nullptr) {
+    src.append(fmt::format(
+        "\"memory_reads\": {},",
+        json_symbol(ir, Symbol{.type = info->memory_reads_type(),
+                               .ptr = info->memory_reads()})));
+    src.append(fmt::format(
+        "\"memory_writes\": {}",
+        json_symbol(ir, Symbol{.type = info->memory_writes_type(),
+                               .ptr = info->memory_writes()})));
+  } else {
+    src.append("\"memory_reads\": null,");
+    src.append("\"memory_writes\": null");
+  }
+}
+
+} // namespace vkdt_denox
+
+std::string vkdt_denox::create_cost_manifest(
+    const SymbolicIR &symbolic_ir, const ComputeGraph &compute_graph,
+    const ShaderRegistry &shader_registry, std::string_view module_name) {
+  SourceWriter src;
+  src.append("{");
+  src.push_indentation();
+  src.append(fmt::format("\"module\": {},", json_string(module_name)));
+  write_symbols(src, symbolic_ir);
+
+  src.append("\"nodes\": [");
+  src.push_indentation();
+  const std::size_t n = compute_graph.nodes.size();
+  for (std::size_t nid = 0; nid < n; ++nid) {
+    const auto &node = compute_graph.nodes[nid];
+    src.append("{");
+    src.push_indentation();
+    if (std::holds_alternative<ComputeDispatch>(node.op)) {
+      write_dispatch(src, symbolic_ir, std::get<ComputeDispatch>(node.op),
+                     shader_registry);
+    } else {
+      const auto &upload = std::get<Upload>(node.op);
+      src.append("\"type\": \"upload\",");
+      src.append(fmt::format("\"node\": {}", json_string(upload.name)));
+    }
+    src.pop_indentation();
+    src.append(nid + 1 == n ? "}" : "},");
+  }
+  src.pop_indentation();
+  src.append("]");
+  src.pop_indentation();
+  src.append("}");
+  return src.finish();
+}
+
+std::vector<vkdt_denox::DispatchCost> vkdt_denox::evaluate_dispatch_costs(
+    const SymbolicIR &symbolic_ir, const ComputeGraph &compute_graph,
+    const ShaderRegistry &shader_registry, std::span<const int64_t> vars) {
+  const std::vector<int64_t> values =
+      evaluate_symbolic_ir(symbolic_ir, vars);
+  auto optional_value = [&](denox::dnx::ScalarSource type,
+                            const void *ptr) -> std::optional<int64_t> {
+    if (type == denox::dnx::ScalarSource_NONE) {
+      return std::nullopt;
+    }
+    return evaluate_symbol(values, Symbol{.type = type, .ptr = ptr});
+  };
+
+  std::vector<DispatchCost> costs;
+  for (const auto &node : compute_graph.nodes) {
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    const auto &dispatch = std::get<ComputeDispatch>(node.op);
+    DispatchCost cost{
+        .node = dispatch.name,
+        .shader = shader_registry.binaries[dispatch.binary_id].name,
+        .workgroup_count =
+            {
+                evaluate_symbol(values, dispatch.workgroup_count_x),
+                evaluate_symbol(values, dispatch.workgroup_count_y),
+                evaluate_symbol(values, dispatch.workgroup_count_z),
+            },
+        .memory_reads = std::nullopt,
+        .memory_writes = std::nullopt,
+    };
+    if (dispatch.info != nullptr) {
+      cost.memory_reads = optional_value(dispatch.info->memory_reads_type(),
+                                         dispatch.info->memory_reads());
+      cost.memory_writes = optional_value(dispatch.info->memory_writes_type(),
+                                          dispatch.info->memory_writes());
+    }
+    costs.push_back(std::move(cost));
+  }
+  return costs;
+}
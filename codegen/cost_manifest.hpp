@@ -0,0 +1,42 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include "shader_registry.hpp"
+#include "symbolics.hpp"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace vkdt_denox {
+
+/// Quoted JSON string with escaped special characters.
+std::string json_string(std::string_view str);
+
+/// JSON description of every generated node: source dispatch, shader,
+/// workgroup counts, push constant layout and the symbolic memory traffic.
+/// Symbolic values refer to the variables or to the "symbols" table, which
+/// mirrors the expressions of the generated C code.
+std::string create_cost_manifest(const SymbolicIR &symbolic_ir,
+                                 const ComputeGraph &compute_graph,
+                                 const ShaderRegistry &shader_registry,
+                                 std::string_view module_name);
+
+struct DispatchCost {
+  std::string node;
+  std::string shader;
+  std::array<int64_t, 3> workgroup_count;
+  std::optional<int64_t> memory_reads;
+  std::optional<int64_t> memory_writes;
+};
+
+/// Evaluates the cost of every dispatch for concrete variable values.
+std::vector<DispatchCost>
+evaluate_dispatch_costs(const SymbolicIR &symbolic_ir,
+                        const ComputeGraph &compute_graph,
+                        const ShaderRegistry &shader_registry,
+                        std::span<const int64_t> vars);
+
+} // namespace vkdt_denox
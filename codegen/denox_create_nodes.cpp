@@ -1,122 +1,18 @@
 #include "denox_create_nodes.hpp"
 #include "compute_graph.hpp"
+#include "symbolic_codegen.hpp"
 #include "symbolics.hpp"
+#include <cstdio>
 #include <dnx.h>
 #include <filesystem>
 #include <fmt/base.h>
+#include <fmt/ranges.h>
 #include <stdexcept>
+#include <unordered_set>
 #include <variant>
 
 namespace vkdt_denox {
 
-static void eval_symbolics(SourceWriter &src, const SymbolicIR &ir,
-                           const std::vector<bool> &referenced_symbols) {
-
-  const uint32_t m = ir.symir->ops()->size();
-  const uint32_t k = ir.vars.size();
-  const uint32_t n = k + m;
-
-  std::vector<std::string> symbol_names(n);
-  for (size_t i = 0; i < k; ++i) {
-    symbol_names[i] = ir.vars[i];
-  }
-
-  std::vector<uint32_t> ref_counts(n);
-  for (uint32_t i = 0; i < n; ++i) {
-    ref_counts[i] = referenced_symbols[i] ? 1 : 0;
-  }
-
-  std::vector<std::string> expressions(m);
-  for (uint32_t i = 0; i < m; ++i) {
-    uint32_t sid = k + i;
-    const auto *op = ir.symir->ops()->Get(i);
-    const auto opcode = op->opcode();
-
-    std::string lhs;
-    if (opcode & denox::dnx::SymIROpCode_LHSC) {
-      lhs = fmt::format("{}", op->lhs());
-    } else {
-      uint32_t sid = op->lhs();
-      lhs = symbol_names[sid];
-      ++ref_counts[op->lhs()];
-    }
-
-    std::string rhs;
-    if (opcode & denox::dnx::SymIROpCode_RHSC) {
-      rhs = fmt::format("{}", op->rhs());
-    } else {
-      uint32_t sid = op->rhs();
-      rhs = symbol_names[sid];
-      ++ref_counts[op->rhs()];
-    }
-
-    auto mask = ~denox::dnx::SymIROpCode_LHSC & ~denox::dnx::SymIROpCode_RHSC;
-
-    auto operation = opcode & mask;
-
-    std::string expr;
-    if (operation == denox::dnx::SymIROpCode_ADD) {
-      expr = fmt::format("{} + {}", lhs, rhs);
-    } else if (operation == denox::dnx::SymIROpCode_SUB) {
-      expr = fmt::format("{} - {}", lhs, rhs);
-    } else if (operation == denox::dnx::SymIROpCode_MUL) {
-      expr = fmt::format("{} * {}", lhs, rhs);
-    } else if (operation == denox::dnx::SymIROpCode_DIV) {
-      expr = fmt::format("{} / {}", lhs, rhs);
-    } else if (operation == denox::dnx::SymIROpCode_MOD) {
-      expr = fmt::format("(({} % {}) + {}) % {}", lhs, rhs, rhs, rhs);
-    } else if (operation == denox::dnx::SymIROpCode_MIN) {
-      expr = fmt::format("{} < {} ? {} : {}", lhs, rhs, lhs, rhs);
-    } else if (operation == denox::dnx::SymIROpCode_MAX) {
-      expr = fmt::format("{} < {} ? {} : {}", lhs, rhs, rhs, lhs);
-    }
-
-    std::string symbol_name = fmt::format("r{}", sid);
-    symbol_names[sid] = symbol_name;
-    expressions[i] = fmt::format("const int64_t {} = {};", symbol_name, expr);
-  }
-
-  std::vector<bool> pruned_expressions(m, false);
-
-  while (true) {
-    bool pruned_once = false;
-
-    for (uint32_t i = 0; i < m; ++i) {
-      uint32_t sid = i + k;
-      if (pruned_expressions[i]) {
-        continue;
-      }
-      if (ref_counts[sid] > 0) {
-        continue;
-      }
-      pruned_expressions[i] = true;
-      pruned_once = true;
-      const auto *op = ir.symir->ops()->Get(i);
-      if (!(op->opcode() & denox::dnx::SymIROpCode_LHSC)) {
-        uint32_t sid = op->lhs();
-        assert(ref_counts[sid] > 0);
-        --ref_counts[sid];
-      }
-
-      if (!(op->opcode() & denox::dnx::SymIROpCode_RHSC)) {
-        uint32_t sid = op->rhs();
-        assert(ref_counts[sid] > 0);
-        --ref_counts[sid];
-      }
-    }
-
-    if (!pruned_once) {
-      break;
-    }
-  }
-
-  for (uint32_t i = 0; i < m; ++i) {
-    if (ref_counts[k + i] > 0) {
-      src.append(expressions[i]);
-    }
-  }
-}
-
 static size_t sinksource_format_size(vkdt_denox::SinkSourceFormat format) {
   switch (format) {
   case vkdt_denox::SinkSourceFormat::F16:
@@ -130,33 +26,18 @@ static size_t sinksource_format_size(vkdt_denox::SinkSourceFormat format) {
   throw std::runtime_error("unreachable");
 }
 
-static std::string access_symbol(const SymbolicIR &ir,
-                                 vkdt_denox::Symbol symbol,
-                                 std::vector<bool> &referenced_symbols) {
-  if (symbol.type == denox::dnx::ScalarSource_symbolic) {
-    const auto *sym_ref = static_cast<const denox::dnx::SymRef *>(symbol.ptr);
-    const uint32_t sid = sym_ref->sid();
-    referenced_symbols[sid] = true;
-    if (sid < ir.vars.size()) {
-      return ir.vars[sid];
-    } else {
-      return fmt::format("r{}", sym_ref->sid());
-    }
-  } else if (symbol.type == denox::dnx::ScalarSource_literal) {
-    return fmt::format(
-        "{}", vkdt_denox::read_unsigned_scalar_literal(
-                  static_cast<const denox::dnx::ScalarLiteral *>(symbol.ptr)));
-  } else {
-    throw std::runtime_error("invalid scalar source type!");
-  }
-}
-
 static void create_buffer_rois(SourceWriter &src, const SymbolicIR &symbolic_ir,
                                const ComputeGraph &compute_graph,
-                               std::vector<bool> &referenced_symbols) {
+                               std::vector<bool> &referenced_symbols,
+                               std::vector<bool> *bucket_referenced_symbols) {
+  const std::vector<bool> external = external_buffer_rois(compute_graph);
   uint32_t n = compute_graph.buffer_rois.size();
   for (uint32_t i = 0; i < n; ++i) {
     const auto &buffer_roi = compute_graph.buffer_rois[i];
+    const bool bucketed = bucket_referenced_symbols != nullptr && !external[i];
+    std::vector<bool> &roi_referenced_symbols =
+        bucketed ? *bucket_referenced_symbols : referenced_symbols;
+    const std::string_view suffix = bucketed ? "_bucket" : "";
     if (buffer_roi.extent.has_value()) {
       throw std::runtime_error(
           "buffer-rois with extent are not implemented in the codegen!");
@@ -178,12 +59,13 @@ static void create_buffer_rois(SourceWriter &src, const SymbolicIR &symbolic_ir,
         uint32_t format_size = sinksource_format_size(buffer_roi.format);
         src.append(fmt::format(
             "dt_roi_t roi{} = {{.wd = (uint32_t)({} / {}), .ht = 1}};", i,
-            access_symbol(symbolic_ir, symbol, referenced_symbols),
+            access_symbol(symbolic_ir, symbol, roi_referenced_symbols, suffix),
             format_size));
       } else {
         src.append(fmt::format(
             "dt_roi_t roi{} = {{.wd = (uint32_t)({}), .ht = 1}};", i,
-            access_symbol(symbolic_ir, symbol, referenced_symbols)));
+            access_symbol(symbolic_ir, symbol, roi_referenced_symbols,
+                          suffix)));
       }
     }
   }
@@ -243,6 +125,139 @@ sinksource_format_to_string(vkdt_denox::SinkSourceFormat format) {
   throw std::runtime_error("unreachable");
 }
 
+/// The workgroup counts of denox are only exact for the workgroup size that
+/// denox compiled the kernel for. Warns about kernels whose workgroup size
+/// is unknown or may be changed by pipeline specialization.
+static void check_local_size(const ShaderBinary &binary,
+                             std::unordered_set<std::string> &checked) {
+  if (!checked.insert(binary.name).second) {
+    return;
+  }
+  if (!binary.local_size.has_value()) {
+    fmt::println(stderr,
+                 "Warning: could not reflect the workgroup size of kernel {}, "
+                 "its dispatch size cannot be validated.",
+                 binary.name);
+    return;
+  }
+  const auto &local_size = *binary.local_size;
+  std::vector<std::string> spec_ids;
+  for (const auto &spec_id : local_size.spec_ids) {
+    if (spec_id.has_value()) {
+      spec_ids.push_back(fmt::format("{}", *spec_id));
+    }
+  }
+  if (!spec_ids.empty()) {
+    fmt::println(stderr,
+                 "Warning: workgroup size {}x{}x{} of kernel {} is controlled "
+                 "by specialization constants ({}). If the pipeline "
+                 "specializes them, for example to DT_LOCAL_SIZE_X/Y, the "
+                 "dispatch will over- or under-dispatch.",
+                 local_size.size[0], local_size.size[1], local_size.size[2],
+                 binary.name, fmt::join(spec_ids, ", "));
+  }
+}
+
+/// Push constants of processing stages (see --preprocessing):
+///   uint32_t width, height, channels, layout (0: HWC, 1: CHW, 2: CHWC8)
+/// where width, height and channels are the extent of the model tensor.
+static uint32_t inout_layout_index(InOutLayout layout) {
+  switch (layout) {
+  case InOutLayout::HWC:
+    return 0;
+  case InOutLayout::CHW:
+    return 1;
+  case InOutLayout::CHWC8:
+    return 2;
+  }
+  throw std::runtime_error("unreachable");
+}
+
+/// Creates the node of the processing stage of a model input or output, which
+/// reads the vkdt image and writes the input tensor, or reads the output
+/// tensor and writes a vkdt image respectively.
+static void create_stage_node(SourceWriter &src, const SymbolicIR &symbolic_ir,
+                              const InOutDescriptor &descriptor,
+                              std::vector<bool> &referenced_symbols,
+                              std::string_view module_name) {
+  assert(descriptor.stage_kernel.has_value());
+  const auto *info = descriptor.tensor_info;
+  if (info == nullptr || info->width_type() == denox::dnx::ScalarSource_NONE ||
+      info->height_type() == denox::dnx::ScalarSource_NONE ||
+      info->channels_type() == denox::dnx::ScalarSource_NONE) {
+    throw std::runtime_error(fmt::format(
+        "processing stage of {} requires the extent of the tensor.",
+        descriptor.name));
+  }
+  const std::string width = access_symbol(
+      symbolic_ir, Symbol{.type = info->width_type(), .ptr = info->width()},
+      referenced_symbols);
+  const std::string height = access_symbol(
+      symbolic_ir, Symbol{.type = info->height_type(), .ptr = info->height()},
+      referenced_symbols);
+  const std::string channels = access_symbol(
+      symbolic_ir,
+      Symbol{.type = info->channels_type(), .ptr = info->channels()},
+      referenced_symbols);
+
+  const bool input = descriptor.type == SinkSourceType::Read;
+  const std::string stage =
+      fmt::format("{}_{}", descriptor.name, input ? "pre" : "post");
+  src.append(fmt::format("// {} ({}.comp)", input ? "preprocessing of input"
+                                                  : "postprocessing of output",
+                         *descriptor.stage_kernel));
+  src.append(fmt::format(
+      "const uint32_t {}_pc[4] = {{(uint32_t)({}), (uint32_t)({}), "
+      "(uint32_t)({}), {}}};",
+      stage, width, height, channels, inout_layout_index(descriptor.layout)));
+  if (!input) {
+    src.append(fmt::format("dt_roi_t {}_roi = {{.wd = {}, .ht = {}}};", stage,
+                           width, height));
+  }
+  src.append(fmt::format(
+      "const int {}_id = dt_node_add(graph, module, \"{}\", \"{}\",", stage,
+      module_name, *descriptor.stage_kernel));
+  src.push_indentation(2);
+  src.append(fmt::format("{}, {}, 1, sizeof({}_pc), (const int*){}_pc, 2, //",
+                         width, height, stage, stage));
+  const std::string_view format =
+      sinksource_format_to_string(descriptor.format);
+  if (input) {
+    src.append("\"input\", \"read\", \"rgba\", \"*\", dt_no_roi,");
+    src.append(fmt::format(
+        "\"output\", \"write\", \"ssbo\", \"{}\", &roi{});", format,
+        descriptor.buffer_roi_id));
+  } else {
+    src.append(fmt::format(
+        "\"input\", \"read\", \"ssbo\", \"{}\", dt_no_roi,", format));
+    src.append(fmt::format(
+        "\"output\", \"write\", \"rgba\", \"f16\", &{}_roi);", stage));
+  }
+  src.pop_indentation(2);
+
+  // Wire the stage to the connector of the module.
+  src.append(fmt::format("if ({}_connector == NULL) {{", descriptor.name));
+  src.push_indentation();
+  src.append(fmt::format("dt_connector_copy(graph, module, {}_id, {}_id, {});",
+                         descriptor.name, stage, input ? 0 : 1));
+  src.pop_indentation();
+  src.append("} else {");
+  src.push_indentation();
+  if (input) {
+    src.append(fmt::format(
+        "dt_node_connect_named(graph, {0}_id, {0}_connector, {1}_id, "
+        "\"input\");",
+        descriptor.name, stage));
+  } else {
+    src.append(fmt::format(
+        "dt_node_connect_named(graph, {1}_id, \"output\", {0}_id, "
+        "{0}_connector);",
+        descriptor.name, stage));
+  }
+  src.pop_indentation();
+  src.append("}");
+}
+
 static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
                          const ComputeGraph &compute_graph,
                          const ShaderRegistry &shader_registry,
@@ -250,6 +265,7 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
                          std::vector<bool> &referenced_symbols,
                          std::string_view module_name) {
   SourceWriter offset_src;
+  std::unordered_set<std::string> checked_binaries;
 
   const uint32_t n = compute_graph.nodes.size();
   std::vector<std::string> namespaces(n);
@@ -259,19 +275,29 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
     if (std::holds_alternative<ComputeDispatch>(node.op)) {
       const auto &compute_dispatch = std::get<ComputeDispatch>(node.op);
 
-      if (compute_dispatch.info != nullptr) {
-        const denox::dnx::DispatchInfo *info = compute_dispatch.info;
-        if (info->src_path() != nullptr) {
-          std::filesystem::path path = info->src_path()->str();
-          std::string filename = path.filename();
-          src.append(
-              fmt::format("// {} ({})", compute_dispatch.name, filename));
-        } else {
-          src.append(fmt::format("// {}", compute_dispatch.name));
-        }
-      } else {
-        src.append(fmt::format("// {}", compute_dispatch.name));
+      const auto &binary = shader_registry.binaries[compute_dispatch.binary_id];
+      check_local_size(binary, checked_binaries);
+
+      std::string comment = fmt::format("// {}", compute_dispatch.name);
+      if (compute_dispatch.info != nullptr &&
+          compute_dispatch.info->src_path() != nullptr) {
+        std::filesystem::path path = compute_dispatch.info->src_path()->str();
+        comment.append(fmt::format(" ({})", path.filename().string()));
+      }
+      if (compute_dispatch.entry_point != "main") {
+        comment.append(
+            fmt::format(" entry point: {}", compute_dispatch.entry_point));
+      }
+      if (binary.local_size.has_value()) {
+        const auto &size = binary.local_size->size;
+        comment.append(fmt::format(" local size: {}x{}x{}", size[0], size[1],
+                                   size[2]));
       }
+      if (compute_dispatch.workgroup_limit.has_value()) {
+        comment.append(fmt::format(" split: x > {} folded into z",
+                                   *compute_dispatch.workgroup_limit));
+      }
+      src.append(comment);
 
       std::string node_namespace = compute_dispatch.name;
       namespaces[nid] = node_namespace;
@@ -282,20 +308,16 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
         std::ranges::sort(fields, [](const auto &lhs, const auto &rhs) {
           return lhs.offset < rhs.offset;
         });
-
-        bool contigous_u32 = true;
-        for (size_t i = 0; i < pc_count; ++i) {
-          const auto &field = fields[i];
-          if (field.type != PushConstantType::U32) {
-            contigous_u32 = false;
-            break;
+        auto field_value = [&](const PushConstantField &field) {
+          std::string value =
+              access_symbol(symbolic_ir, field.value, referenced_symbols);
+          if (field.addend != 0) {
+            value = fmt::format("({} + {})", value, field.addend);
           }
-          if (field.offset != i * sizeof(uint32_t)) {
-            contigous_u32 = false;
-            break;
-          }
-        }
-        if (contigous_u32) {
+          return value;
+        };
+
+        if (is_contiguous_u32(compute_dispatch.pc)) {
           std::string pcdef =
               fmt::format("const uint32_t {}_pc[{}] = {{", node_namespace,
                           compute_dispatch.pc.size / sizeof(uint32_t));
@@ -305,14 +327,11 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
               pcdef.append(", ");
             }
             first = false;
-            if (field.value.type == denox::dnx::ScalarSource_literal) {
-              pcdef.append(
-                  fmt::format("{}", access_symbol(symbolic_ir, field.value,
-                                                  referenced_symbols)));
+            if (field.value.type == denox::dnx::ScalarSource_literal &&
+                field.addend == 0) {
+              pcdef.append(field_value(field));
             } else {
-              pcdef.append(fmt::format(
-                  "(uint32_t)({})",
-                  access_symbol(symbolic_ir, field.value, referenced_symbols)));
+              pcdef.append(fmt::format("(uint32_t)({})", field_value(field)));
             }
           }
           pcdef.append("};");
@@ -327,15 +346,14 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
           for (uint32_t p = 0; p < pc_count; ++p) {
             const auto &pc = fields[p];
             if (pc.type != PushConstantType::I64) {
-              src.append(fmt::format(
-                  "const {} pc{} = ({}){};",
-                  push_constant_type_to_string(pc.type), p,
-                  push_constant_type_to_string(pc.type),
-                  access_symbol(symbolic_ir, pc.value, referenced_symbols)));
+              src.append(fmt::format("const {} pc{} = ({}){};",
+                                     push_constant_type_to_string(pc.type), p,
+                                     push_constant_type_to_string(pc.type),
+                                     field_value(pc)));
             } else {
-              src.append(fmt::format(
-                  "const {} pc{} = {};", push_constant_type_to_string(pc.type),
-                  p, access_symbol(symbolic_ir, pc.value, referenced_symbols)));
+              src.append(fmt::format("const {} pc{} = {};",
+                                     push_constant_type_to_string(pc.type), p,
+                                     field_value(pc)));
             }
 
             src.append(fmt::format("memcpy({}_pc + {}, &pc{}, sizeof({}));",
@@ -347,21 +365,36 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
         }
       }
 
-      const auto &binary = shader_registry.binaries[compute_dispatch.binary_id];
-
       // === Create node ===
+      // vkdt launches wd / DT_LOCAL_SIZE_X workgroups, scaling the counts
+      // computed by denox by DT_LOCAL_SIZE_* launches exactly those.
       src.append(fmt::format(
           "const int {}_id = dt_node_add(graph, module, \"{}\", \"{}\",",
-          node_namespace, module_name, binary.name));
+          node_namespace,
+          shader_registry.module.empty() ? module_name
+                                         : shader_registry.module,
+          binary.name));
       src.push_indentation(2);
-      src.append(fmt::format(
-          "{} * DT_LOCAL_SIZE_X, {} * DT_LOCAL_SIZE_Y, {},",
-          access_symbol(symbolic_ir, compute_dispatch.workgroup_count_x,
-                        referenced_symbols),
-          access_symbol(symbolic_ir, compute_dispatch.workgroup_count_y,
-                        referenced_symbols),
-          access_symbol(symbolic_ir, compute_dispatch.workgroup_count_z,
-                        referenced_symbols)));
+      const std::string wg_x = access_symbol(
+          symbolic_ir, compute_dispatch.workgroup_count_x, referenced_symbols);
+      const std::string wg_y = access_symbol(
+          symbolic_ir, compute_dispatch.workgroup_count_y, referenced_symbols);
+      const std::string wg_z = access_symbol(
+          symbolic_ir, compute_dispatch.workgroup_count_z, referenced_symbols);
+      if (compute_dispatch.workgroup_limit.has_value()) {
+        // x workgroups beyond the limit are folded into z, the shader
+        // unfolds them again (see split_dispatches.hpp).
+        const uint32_t limit = *compute_dispatch.workgroup_limit;
+        src.append(fmt::format(
+            "({0} < {1} ? {0} : {1}) * DT_LOCAL_SIZE_X, {2} * DT_LOCAL_SIZE_Y,",
+            wg_x, limit, wg_y));
+        src.append(fmt::format("{} * (({} + {}) / {}),", wg_z, wg_x, limit - 1,
+                               limit));
+      } else {
+        src.append(
+            fmt::format("{} * DT_LOCAL_SIZE_X, {} * DT_LOCAL_SIZE_Y, {},",
+                        wg_x, wg_y, wg_z));
+      }
 
       if (compute_dispatch.pc.size != 0) {
         src.append(fmt::format("{}, (const int*){}_pc, {}, //",
@@ -483,9 +516,9 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
                 sinksource.buffer_ssbo_offset;
             offset_src.append(fmt::format(
                 "graph->node[{}_id].connector[{}].ssbo_offset = {};",
-                node_namespace, i, sinksource.buffer_ssbo_offset));
+                node_namespace, i, offset));
           } else {
-            if (sinksource.buffer_ssbo_offset != 0) {
+            if (sinksource.buffer_ssbo_offset == 0) {
               offset_src.append(fmt::format(
                   "graph->node[{}_id].connector[{}].ssbo_offset = {};",
                   node_namespace, i,
@@ -536,11 +569,50 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
       src.pop_indentation(2);
     }
   }
+  // Create processing stages
+  for (const auto &descriptor : compute_graph.input_descriptors) {
+    if (descriptor.stage_kernel.has_value()) {
+      create_stage_node(src, symbolic_ir, descriptor, referenced_symbols,
+                        module_name);
+    }
+  }
+  for (const auto &descriptor : compute_graph.output_descriptors) {
+    if (descriptor.stage_kernel.has_value()) {
+      create_stage_node(src, symbolic_ir, descriptor, referenced_symbols,
+                        module_name);
+    }
+  }
+
   // Create connectors
   const uint32_t m = compute_graph.connectors.size();
   for (uint32_t i = 0; i < m; ++i) {
     const auto &connector = compute_graph.connectors[i];
-    if (connector.src_node == external_sential) {
+    if (connector.src_node == external_sential &&
+        compute_graph.input_descriptors[connector.src_node_sinksource]
+            .stage_kernel.has_value()) {
+      const auto &info =
+          compute_graph.input_descriptors[connector.src_node_sinksource];
+      src.append(fmt::format(
+          "dt_node_connect_named(graph, {}_pre_id, \"output\", {}_id, "
+          "\"{}\");",
+          info.name, namespaces[connector.dst_node],
+          compute_graph.nodes[connector.dst_node]
+              .sinksources[connector.dst_node_sinksource]
+              .name));
+    } else if (connector.dst_node == external_sential &&
+               compute_graph.output_descriptors[connector.dst_node_sinksource]
+                   .stage_kernel.has_value()) {
+      const auto &info =
+          compute_graph.output_descriptors[connector.dst_node_sinksource];
+      src.append(fmt::format(
+          "dt_node_connect_named(graph, {}_id, \"{}\", {}_post_id, "
+          "\"input\");",
+          namespaces[connector.src_node],
+          compute_graph.nodes[connector.src_node]
+              .sinksources[connector.src_node_sinksource]
+              .name,
+          info.name));
+    } else if (connector.src_node == external_sential) {
       assert(connector.dst_node != external_sential);
       const uint32_t input_index = connector.src_node_sinksource;
       const auto &info = compute_graph.input_descriptors[input_index];
@@ -606,20 +678,85 @@ static void create_graph(SourceWriter &src, const SymbolicIR &symbolic_ir,
   src.append(offset_src.finish());
 }
 
+/// Variables, which the referenced symbols depend on.
+static std::vector<bool>
+referenced_variables(const SymbolicIR &ir,
+                     std::vector<bool> referenced_symbols) {
+  const uint32_t k = ir.vars.size();
+  const uint32_t m = ir.symir->ops()->size();
+  // Operands always precede the operation.
+  for (uint32_t i = m; i-- > 0;) {
+    if (!referenced_symbols[k + i]) {
+      continue;
+    }
+    const auto *op = ir.symir->ops()->Get(i);
+    if (!(op->opcode() & denox::dnx::SymIROpCode_LHSC)) {
+      referenced_symbols[op->lhs()] = true;
+    }
+    if (!(op->opcode() & denox::dnx::SymIROpCode_RHSC)) {
+      referenced_symbols[op->rhs()] = true;
+    }
+  }
+  referenced_symbols.resize(k);
+  return referenced_symbols;
+}
+
 } // namespace vkdt_denox
 
+void vkdt_denox::def_func_denox_extent_bucket(
+    SourceWriter &src, const ExtentBuckets &extent_buckets) {
+  src.add_include("stdint.h", IncludeType::System);
+  src.append("static uint64_t denox_extent_bucket(uint64_t extent) {");
+  src.push_indentation();
+  if (extent_buckets.kind == ExtentBucketKind::Multiple) {
+    src.append(fmt::format("return (extent + {}) / {} * {};",
+                           extent_buckets.multiple - 1, extent_buckets.multiple,
+                           extent_buckets.multiple));
+  } else {
+    src.append("uint64_t bucket = 1;");
+    src.append("while (bucket < extent) {");
+    src.push_indentation();
+    src.append(fmt::format("bucket = (bucket * {} + 999) / 1000;",
+                           extent_buckets.growth_permille));
+    src.pop_indentation();
+    src.append("}");
+    src.append("return bucket;");
+  }
+  src.pop_indentation();
+  src.append("}");
+}
+
+void vkdt_denox::eval_bucketed_symbolics(
+    SourceWriter &src, const SymbolicIR &symbolic_ir,
+    const std::vector<bool> &bucket_referenced_symbols) {
+  const std::vector<bool> bucket_vars =
+      referenced_variables(symbolic_ir, bucket_referenced_symbols);
+  for (uint32_t i = 0; i < bucket_vars.size(); ++i) {
+    if (bucket_vars[i]) {
+      src.append(
+          fmt::format("const uint64_t {0}_bucket = denox_extent_bucket({0});",
+                      symbolic_ir.vars[i]));
+    }
+  }
+  eval_symbolics(src, symbolic_ir, bucket_referenced_symbols, "_bucket");
+}
+
 void vkdt_denox::def_func_denox_create_nodes(
     SourceWriter &src, const denox::dnx::Model *dnx,
     const SymbolicIR &symbolic_ir, const ShaderRegistry &shader_registery,
     const CompressedWeights &compresed_weights,
-    const ComputeGraph &compute_graph, const std::string_view module_name) {
+    const ComputeGraph &compute_graph, const std::string_view module_name,
+    const ExtentBuckets &extent_buckets, std::string_view function_name) {
   src.add_include("stdint.h", IncludeType::System);
   src.add_include("string.h", IncludeType::System);
   src.add_include("stddef.h", IncludeType::System);
   src.add_include("modules/api.h", IncludeType::Local);
 
-  std::string def =
-      "static void denox_create_nodes(dt_graph_t* graph, dt_module_t* module";
+  const bool bucketed = extent_buckets.kind != ExtentBucketKind::None &&
+                        !symbolic_ir.vars.empty();
+
+  std::string def = fmt::format(
+      "static void {}(dt_graph_t* graph, dt_module_t* module", function_name);
   if (symbolic_ir.vars.empty()) {
     def.append(") {");
     src.append(def);
@@ -667,12 +804,18 @@ void vkdt_denox::def_func_denox_create_nodes(
       symbolic_ir.symir->ops()->size() + symbolic_ir.vars.size(), false);
   SourceWriter comp_src;
 
-  create_buffer_rois(comp_src, symbolic_ir, compute_graph, referenced_symbols);
+  std::vector<bool> bucket_referenced_symbols(referenced_symbols.size(), false);
+
+  create_buffer_rois(comp_src, symbolic_ir, compute_graph, referenced_symbols,
+                     bucketed ? &bucket_referenced_symbols : nullptr);
   create_graph(comp_src, symbolic_ir, compute_graph, shader_registery, dnx,
                referenced_symbols, module_name);
 
   SourceWriter sym_src;
   eval_symbolics(sym_src, symbolic_ir, referenced_symbols);
+  if (bucketed) {
+    eval_bucketed_symbolics(sym_src, symbolic_ir, bucket_referenced_symbols);
+  }
 
   src.append(sym_src.finish());
   src.append(comp_src.finish());
@@ -8,11 +8,41 @@
 #include <dnx.h>
 namespace vkdt_denox {
 
+enum class ExtentBucketKind {
+  None,
+  Multiple,
+  Geometric,
+};
+
+/// Dynamic extents are rounded up to buckets for the allocation of
+/// intermediate buffers, such that small changes of the extents do not
+/// change the buffer sizes. Dispatches always use the exact extents.
+struct ExtentBuckets {
+  ExtentBucketKind kind = ExtentBucketKind::None;
+  // Multiple: extents are rounded up to multiples of it.
+  uint32_t multiple = 1;
+  // Geometric: bucket i + 1 is ceil(bucket i * growth / 1000).
+  uint32_t growth_permille = 1000;
+};
+
+/// Defines denox_extent_bucket, which def_func_denox_create_nodes uses for
+/// bucketed extents. Has to be emitted once per module.
+void def_func_denox_extent_bucket(SourceWriter &src,
+                                  const ExtentBuckets &extent_buckets);
+
+/// Emits <var>_bucket, the bucketed extents, and the definitions of all
+/// referenced symbols evaluated for them (with the suffix "_bucket").
+void eval_bucketed_symbolics(
+    SourceWriter &src, const SymbolicIR &symbolic_ir,
+    const std::vector<bool> &bucket_referenced_symbols);
+
 void def_func_denox_create_nodes(SourceWriter &src, const denox::dnx::Model *dnx,
                           const SymbolicIR &symbolic_ir,
                           const ShaderRegistry &shader_registery,
                           const CompressedWeights &compresed_weights,
                           const ComputeGraph &compute_graph,
-                          const std::string_view module_name);
+                          const std::string_view module_name,
+                          const ExtentBuckets &extent_buckets = {},
+                          std::string_view function_name = "denox_create_nodes");
 
 } // namespace vkdt_denox
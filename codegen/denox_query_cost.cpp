@@ -0,0 +1,164 @@
+#include "denox_query_cost.hpp"
+#include "denox_create_nodes.hpp"
+#include "symbolic_codegen.hpp"
+#include <dnx.h>
+#include <variant>
+
+namespace vkdt_denox {
+
+static std::string buffer_roi_bytes(const SymbolicIR &symbolic_ir,
+                                    const BufferRoi &buffer_roi,
+                                    std::vector<bool> &referenced_symbols,
+                                    std::string_view suffix) {
+  if (std::holds_alternative<Symbol>(buffer_roi.byte_size)) {
+    return fmt::format("(uint64_t)({})",
+                       access_symbol(symbolic_ir,
+                                     std::get<Symbol>(buffer_roi.byte_size),
+                                     referenced_symbols, suffix));
+  }
+  return fmt::format("{}", std::get<uint64_t>(buffer_roi.byte_size));
+}
+
+/// Buffers are alive from the first to the last node which connects them,
+/// the peak is the maximum of the bytes alive at any node. Like
+/// denox_create_nodes, intermediate buffers are sized for the bucketed
+/// extents, if bucket_referenced_symbols is given.
+static void
+query_peak_buffer_bytes(SourceWriter &src, const SymbolicIR &symbolic_ir,
+                        const ComputeGraph &compute_graph,
+                        std::vector<bool> &referenced_symbols,
+                        std::vector<bool> *bucket_referenced_symbols) {
+  const std::vector<bool> external = external_buffer_rois(compute_graph);
+  auto roi_bytes = [&](uint32_t roi) {
+    const bool bucketed =
+        bucket_referenced_symbols != nullptr && !external[roi];
+    return buffer_roi_bytes(
+        symbolic_ir, compute_graph.buffer_rois[roi],
+        bucketed ? *bucket_referenced_symbols : referenced_symbols,
+        bucketed ? "_bucket" : "");
+  };
+  const uint32_t roi_count = compute_graph.buffer_rois.size();
+  const uint32_t n = compute_graph.nodes.size();
+  std::vector<uint32_t> first_use(roi_count, none_sentinal);
+  std::vector<uint32_t> last_use(roi_count, none_sentinal);
+  for (uint32_t nid = 0; nid < n; ++nid) {
+    for (const auto &sinksource : compute_graph.nodes[nid].sinksources) {
+      const uint32_t roi = sinksource.buffer_roi_id;
+      if (first_use[roi] == none_sentinal) {
+        first_use[roi] = nid;
+      }
+      last_use[roi] = nid;
+    }
+  }
+
+  src.append("uint64_t live_bytes = 0;");
+  src.append("cost->peak_buffer_bytes = 0;");
+  for (uint32_t nid = 0; nid < n; ++nid) {
+    bool allocates = false;
+    for (uint32_t roi = 0; roi < roi_count; ++roi) {
+      if (first_use[roi] == nid) {
+        src.append(fmt::format("live_bytes += {};", roi_bytes(roi)));
+        allocates = true;
+      }
+    }
+    if (allocates) {
+      src.append("if (live_bytes > cost->peak_buffer_bytes) {");
+      src.push_indentation();
+      src.append("cost->peak_buffer_bytes = live_bytes;");
+      src.pop_indentation();
+      src.append("}");
+    }
+    for (uint32_t roi = 0; roi < roi_count; ++roi) {
+      if (last_use[roi] == nid) {
+        src.append(fmt::format("live_bytes -= {};", roi_bytes(roi)));
+      }
+    }
+  }
+}
+
+} // namespace vkdt_denox
+
+void vkdt_denox::def_struct_denox_cost(SourceWriter &src) {
+  src.add_include("stdint.h", IncludeType::System);
+  src.append("typedef struct denox_cost_t {");
+  src.push_indentation();
+  src.append("uint64_t peak_buffer_bytes;");
+  src.append("uint64_t weight_bytes;");
+  src.append("uint32_t dispatch_count;");
+  src.append("uint64_t memory_reads;");
+  src.append("uint64_t memory_writes;");
+  src.pop_indentation();
+  src.append("} denox_cost_t;");
+}
+
+void vkdt_denox::def_func_denox_query_cost(
+    SourceWriter &src, const SymbolicIR &symbolic_ir,
+    const ComputeGraph &compute_graph,
+    const CompressedWeights &compressed_weights,
+    const ExtentBuckets &extent_buckets, std::string_view function_name) {
+  src.add_include("stdint.h", IncludeType::System);
+
+  std::string def = fmt::format("static inline void {}(", function_name);
+  for (const auto &var : symbolic_ir.vars) {
+    def.append(fmt::format("uint64_t {}, ", var));
+  }
+  def.append("denox_cost_t* cost) {");
+  src.append(def);
+  src.push_indentation();
+
+  std::vector<bool> referenced_symbols(
+      symbolic_ir.symir->ops()->size() + symbolic_ir.vars.size(), false);
+  SourceWriter cost_src;
+
+  const bool bucketed = extent_buckets.kind != ExtentBucketKind::None &&
+                        !symbolic_ir.vars.empty();
+  std::vector<bool> bucket_referenced_symbols(referenced_symbols.size(), false);
+  query_peak_buffer_bytes(cost_src, symbolic_ir, compute_graph,
+                          referenced_symbols,
+                          bucketed ? &bucket_referenced_symbols : nullptr);
+  cost_src.append(fmt::format("cost->weight_bytes = {};",
+                              compressed_weights.byte_size));
+
+  uint32_t dispatch_count = 0;
+  cost_src.append("cost->memory_reads = 0;");
+  cost_src.append("cost->memory_writes = 0;");
+  for (const auto &node : compute_graph.nodes) {
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    ++dispatch_count;
+    const auto *info = std::get<ComputeDispatch>(node.op).info;
+    if (info == nullptr) {
+      continue;
+    }
+    if (info->memory_reads_type() != denox::dnx::ScalarSource_NONE) {
+      cost_src.append(fmt::format(
+          "cost->memory_reads += (uint64_t)({});",
+          access_symbol(symbolic_ir,
+                        Symbol{.type = info->memory_reads_type(),
+                               .ptr = info->memory_reads()},
+                        referenced_symbols)));
+    }
+    if (info->memory_writes_type() != denox::dnx::ScalarSource_NONE) {
+      cost_src.append(fmt::format(
+          "cost->memory_writes += (uint64_t)({});",
+          access_symbol(symbolic_ir,
+                        Symbol{.type = info->memory_writes_type(),
+                               .ptr = info->memory_writes()},
+                        referenced_symbols)));
+    }
+  }
+  cost_src.append(fmt::format("cost->dispatch_count = {};", dispatch_count));
+
+  SourceWriter sym_src;
+  eval_symbolics(sym_src, symbolic_ir, referenced_symbols);
+  if (bucketed) {
+    eval_bucketed_symbolics(sym_src, symbolic_ir, bucket_referenced_symbols);
+  }
+
+  src.append(sym_src.finish());
+  src.append(cost_src.finish());
+
+  src.pop_indentation();
+  src.append("}");
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "compress_weights.hpp"
+#include "compute_graph.hpp"
+#include "denox_create_nodes.hpp"
+#include "source_writer.hpp"
+#include "symbolics.hpp"
+namespace vkdt_denox {
+
+/// Defines denox_cost_t, the result of denox_query_cost.
+void def_struct_denox_cost(SourceWriter &src);
+
+/// Defines denox_query_cost, which evaluates the memory requirements and the
+/// traffic of the model for a resolution, before any node is created. The
+/// extent buckets have to match the ones of def_func_denox_create_nodes.
+void def_func_denox_query_cost(
+    SourceWriter &src, const SymbolicIR &symbolic_ir,
+    const ComputeGraph &compute_graph,
+    const CompressedWeights &compressed_weights,
+    const ExtentBuckets &extent_buckets = {},
+    std::string_view function_name = "denox_query_cost");
+
+} // namespace vkdt_denox
@@ -48,7 +48,7 @@ void vkdt_denox::def_func_denox_read_source(
     src.append("fseek(f, 0, SEEK_END);");
     src.append("const size_t size = ftell(f);");
     src.append(fmt::format("const size_t expected_size = {};",
-                           compressed_weights.data.size()));
+                           compressed_weights.byte_size));
 
     src.append("if (size != expected_size) {");
     src.push_indentation();
@@ -0,0 +1,236 @@
+#include "denox_roi.hpp"
+#include "symbolic_codegen.hpp"
+#include <cstdio>
+#include <fmt/base.h>
+#include <optional>
+#include <stdexcept>
+
+namespace vkdt_denox {
+
+static constexpr int64_t reference_extent = 1 << 14;
+static constexpr int64_t max_alignment = 1024;
+
+namespace {
+
+struct Extent {
+  Symbol width;
+  Symbol height;
+};
+
+struct ExtentMapping {
+  // indices of the width and height variables.
+  uint32_t width_var;
+  uint32_t height_var;
+  Extent output;
+};
+
+} // namespace
+
+static std::optional<Extent> tensor_extent(const denox::dnx::Model *dnx,
+                                           uint32_t tensor_id) {
+  const auto *info = dnx->tensors()->Get(tensor_id)->info();
+  if (info == nullptr ||
+      info->width_type() == denox::dnx::ScalarSource_NONE ||
+      info->height_type() == denox::dnx::ScalarSource_NONE) {
+    return std::nullopt;
+  }
+  return Extent{
+      .width = Symbol{.type = info->width_type(), .ptr = info->width()},
+      .height = Symbol{.type = info->height_type(), .ptr = info->height()},
+  };
+}
+
+static std::optional<uint32_t> plain_variable(const SymbolicIR &ir,
+                                              Symbol symbol) {
+  if (symbol.type != denox::dnx::ScalarSource_symbolic) {
+    return std::nullopt;
+  }
+  const auto *sym_ref = static_cast<const denox::dnx::SymRef *>(symbol.ptr);
+  const uint32_t sid = sym_ref->sid();
+  if (sid >= ir.vars.size()) {
+    return std::nullopt;
+  }
+  return sid;
+}
+
+/// The helpers require that the input extent consists of exactly the
+/// variables of the model.
+static std::optional<ExtentMapping>
+extent_mapping(const denox::dnx::Model *dnx, const SymbolicIR &ir) {
+  if (dnx->inputs()->size() == 0 || dnx->outputs()->size() == 0) {
+    return std::nullopt;
+  }
+  const auto input = tensor_extent(dnx, dnx->inputs()->Get(0));
+  const auto output = tensor_extent(dnx, dnx->outputs()->Get(0));
+  if (!input.has_value() || !output.has_value() || ir.vars.size() != 2) {
+    return std::nullopt;
+  }
+  const auto width_var = plain_variable(ir, input->width);
+  const auto height_var = plain_variable(ir, input->height);
+  if (!width_var.has_value() || !height_var.has_value() ||
+      *width_var == *height_var) {
+    return std::nullopt;
+  }
+  return ExtentMapping{
+      .width_var = *width_var,
+      .height_var = *height_var,
+      .output = *output,
+  };
+}
+
+static std::optional<std::pair<int64_t, int64_t>>
+evaluate_output_extent(const SymbolicIR &ir, const ExtentMapping &mapping,
+                       int64_t width, int64_t height) {
+  std::vector<int64_t> vars(ir.vars.size());
+  vars[mapping.width_var] = width;
+  vars[mapping.height_var] = height;
+  try {
+    const auto values = evaluate_symbolic_ir(ir, vars);
+    return std::make_pair(evaluate_symbol(values, mapping.output.width),
+                          evaluate_symbol(values, mapping.output.height));
+  } catch (const std::runtime_error &) {
+    return std::nullopt;
+  }
+}
+
+/// Smallest power of two, such that all input extents which are multiples
+/// of it are mapped exactly proportional to the output extent, e.g. the
+/// product of the pooling strides of a U-Net.
+static std::optional<int64_t>
+extent_alignment(const SymbolicIR &ir, const ExtentMapping &mapping,
+                 bool width, std::pair<int64_t, int64_t> ref) {
+  const int64_t ref_out = width ? ref.first : ref.second;
+  for (int64_t alignment = 1; alignment <= max_alignment; alignment *= 2) {
+    bool proportional = true;
+    for (int64_t k = 1; k <= 32 && proportional; ++k) {
+      const int64_t extent = k * alignment;
+      const auto out =
+          width ? evaluate_output_extent(ir, mapping, extent, reference_extent)
+                : evaluate_output_extent(ir, mapping, reference_extent, extent);
+      proportional =
+          out.has_value() && (width ? out->first : out->second) *
+                                     reference_extent ==
+                                 extent * ref_out;
+    }
+    if (proportional) {
+      return alignment;
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace vkdt_denox
+
+void vkdt_denox::def_func_denox_roi(SourceWriter &src,
+                                    const denox::dnx::Model *dnx,
+                                    const SymbolicIR &symbolic_ir) {
+  const auto mapping = extent_mapping(dnx, symbolic_ir);
+  if (!mapping.has_value()) {
+    fmt::println(stderr, "Warning: the input extent of the model is not given "
+                         "by exactly two variables, ROI helpers are not "
+                         "generated.");
+    return;
+  }
+  const auto ref = evaluate_output_extent(symbolic_ir, *mapping,
+                                          reference_extent, reference_extent);
+  if (!ref.has_value() || ref->first <= 0 || ref->second <= 0) {
+    fmt::println(stderr, "Warning: failed to evaluate the output extent of "
+                         "the model, ROI helpers are not generated.");
+    return;
+  }
+  auto alignment_wd = extent_alignment(symbolic_ir, *mapping, true, *ref);
+  auto alignment_ht = extent_alignment(symbolic_ir, *mapping, false, *ref);
+  if (!alignment_wd.has_value() || !alignment_ht.has_value()) {
+    fmt::println(stderr, "Warning: the output extent of the model is not "
+                         "proportional to its input extent, "
+                         "denox_input_extent only approximates it.");
+  }
+
+  src.add_include("stdint.h", IncludeType::System);
+  src.add_include("modules/api.h", IncludeType::Local);
+
+  src.append("#define DENOX_ROI_HELPERS");
+  src.append("\n");
+  src.append("// Input extents have to be multiples of the alignment, such "
+             "that the output");
+  src.append("// extent is exactly proportional to the input extent.");
+  src.append("enum {");
+  src.push_indentation();
+  src.append(fmt::format("denox_roi_align_wd = {},", alignment_wd.value_or(1)));
+  src.append(fmt::format("denox_roi_align_ht = {},", alignment_ht.value_or(1)));
+  src.pop_indentation();
+  src.append("};");
+  src.append("\n");
+
+  const std::string &width_var = symbolic_ir.vars[mapping->width_var];
+  const std::string &height_var = symbolic_ir.vars[mapping->height_var];
+  src.append(fmt::format("static inline void denox_output_extent(uint64_t {}, "
+                         "uint64_t {},",
+                         width_var, height_var));
+  src.append("                                       uint32_t* out_wd, "
+             "uint32_t* out_ht) {");
+  src.push_indentation();
+  std::vector<bool> referenced_symbols(
+      symbolic_ir.symir->ops()->size() + symbolic_ir.vars.size(), false);
+  SourceWriter extent_src;
+  extent_src.append(fmt::format(
+      "*out_wd = (uint32_t)({});",
+      access_symbol(symbolic_ir, mapping->output.width, referenced_symbols)));
+  extent_src.append(fmt::format(
+      "*out_ht = (uint32_t)({});",
+      access_symbol(symbolic_ir, mapping->output.height, referenced_symbols)));
+  SourceWriter sym_src;
+  eval_symbolics(sym_src, symbolic_ir, referenced_symbols);
+  src.append(sym_src.finish());
+  src.append(extent_src.finish());
+  src.pop_indentation();
+  src.append("}");
+  src.append("\n");
+
+  // Inverse of the (proportional) mapping, rounded up to the alignment.
+  src.append("static inline void denox_input_extent(uint32_t out_wd, "
+             "uint32_t out_ht,");
+  src.append("                                      uint32_t* in_wd, "
+             "uint32_t* in_ht) {");
+  src.push_indentation();
+  src.append(fmt::format("const uint64_t wd = ((uint64_t)out_wd * {} + {}) / "
+                         "{};",
+                         reference_extent, ref->first - 1, ref->first));
+  src.append(fmt::format("const uint64_t ht = ((uint64_t)out_ht * {} + {}) / "
+                         "{};",
+                         reference_extent, ref->second - 1, ref->second));
+  src.append("*in_wd = (uint32_t)((wd + denox_roi_align_wd - 1) / "
+             "denox_roi_align_wd * denox_roi_align_wd);");
+  src.append("*in_ht = (uint32_t)((ht + denox_roi_align_ht - 1) / "
+             "denox_roi_align_ht * denox_roi_align_ht);");
+  src.pop_indentation();
+  src.append("}");
+  src.append("\n");
+
+  src.append("static inline void denox_modify_roi_out(const dt_roi_t* input, "
+             "dt_roi_t* output) {");
+  src.push_indentation();
+  src.append("uint32_t wd, ht;");
+  src.append("denox_output_extent(input->full_wd, input->full_ht, &wd, &ht);");
+  src.append("output->full_wd = wd;");
+  src.append("output->full_ht = ht;");
+  src.pop_indentation();
+  src.append("}");
+  src.append("\n");
+
+  src.append("static inline void denox_modify_roi_in(const dt_roi_t* output, "
+             "dt_roi_t* input) {");
+  src.push_indentation();
+  src.append("uint32_t wd, ht;");
+  src.append("denox_input_extent(output->wd, output->ht, &wd, &ht);");
+  src.append("// The alignment may round beyond the scaled full input.");
+  src.append("const uint32_t max_wd = (uint32_t)(input->full_wd / "
+             "output->scale + 0.5f);");
+  src.append("const uint32_t max_ht = (uint32_t)(input->full_ht / "
+             "output->scale + 0.5f);");
+  src.append("input->wd = wd < max_wd ? wd : max_wd;");
+  src.append("input->ht = ht < max_ht ? ht : max_ht;");
+  src.append("input->scale = output->scale;");
+  src.pop_indentation();
+  src.append("}");
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "source_writer.hpp"
+#include "symbolics.hpp"
+#include <dnx.h>
+namespace vkdt_denox {
+
+/// Defines extent and ROI helpers, which map between the extents of the
+/// first input and the first output of the model, such that the module can
+/// run the network at the scaled working resolution of vkdt.
+void def_func_denox_roi(SourceWriter &src, const denox::dnx::Model *dnx,
+                        const SymbolicIR &symbolic_ir);
+
+} // namespace vkdt_denox
@@ -0,0 +1,214 @@
+#include "denox_variants.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fmt/base.h>
+#include <stdexcept>
+
+namespace vkdt_denox {
+
+static std::string join(const std::vector<std::string> &strs) {
+  std::string joined;
+  for (std::size_t i = 0; i < strs.size(); ++i) {
+    if (i != 0) {
+      joined.append(", ");
+    }
+    joined.append(strs[i]);
+  }
+  return joined;
+}
+
+static void
+def_func_denox_select_variant(SourceWriter &src, const SymbolicIR &symbolic_ir,
+                              std::span<const VariantTarget> targets) {
+  const std::size_t k = symbolic_ir.vars.size();
+  std::vector<std::string> params;
+  for (const auto &var : symbolic_ir.vars) {
+    params.push_back(fmt::format("uint64_t {}", var));
+  }
+  src.append(
+      fmt::format("static int denox_select_variant({}) {{", join(params)));
+  src.push_indentation();
+
+  const bool any_cooperative_matrix =
+      std::ranges::any_of(targets, &VariantTarget::cooperative_matrix);
+  src.append(fmt::format("// optimization targets, ordered as {}, variants "
+                         "without a target are zero.",
+                         join(symbolic_ir.vars)));
+  src.append(fmt::format("static const uint64_t targets[{}][{}] = {{",
+                         targets.size(), k));
+  src.push_indentation();
+  for (const auto &target : targets) {
+    std::vector<std::string> extents;
+    for (std::size_t i = 0; i < k; ++i) {
+      extents.push_back(
+          fmt::format("{}", target.extents.empty() ? 0 : target.extents[i]));
+    }
+    src.append(fmt::format("{{{}}},", join(extents)));
+  }
+  src.pop_indentation();
+  src.append("};");
+  if (any_cooperative_matrix) {
+    std::vector<std::string> flags;
+    for (const auto &target : targets) {
+      flags.push_back(target.cooperative_matrix ? "1" : "0");
+    }
+    src.append(fmt::format("static const int cooperative_matrix[{}] = {{{}}};",
+                           targets.size(), join(flags)));
+  }
+  src.append(fmt::format("const uint64_t extents[{}] = {{{}}};", k,
+                         join(symbolic_ir.vars)));
+
+  src.append("int best = 0;");
+  src.append("uint64_t best_distance = UINT64_MAX;");
+  src.append(fmt::format("for (int v = 0; v < {}; ++v) {{", targets.size()));
+  src.push_indentation();
+  if (any_cooperative_matrix) {
+    src.append("if (cooperative_matrix[v] && !DENOX_COOPMAT_SUPPORTED) {");
+    src.push_indentation();
+    src.append("continue;");
+    src.pop_indentation();
+    src.append("}");
+  }
+  src.append("// sum of the ratios between extents and targets, in 1/1024.");
+  src.append("uint64_t distance = targets[v][0] ? 0 : UINT64_MAX - 1;");
+  src.append(fmt::format("for (int i = 0; targets[v][0] && i < {}; ++i) {{",
+                         k));
+  src.push_indentation();
+  src.append("const uint64_t e = extents[i] ? extents[i] : 1;");
+  src.append("const uint64_t t = targets[v][i];");
+  src.append("distance += e > t ? e * 1024 / t : t * 1024 / e;");
+  src.pop_indentation();
+  src.append("}");
+  if (any_cooperative_matrix) {
+    // Equally close variants prefer the faster cooperative matrix kernels.
+    src.append("if (distance < best_distance ||");
+    src.append("    (distance == best_distance && cooperative_matrix[v] &&");
+    src.append("     !cooperative_matrix[best])) {");
+  } else {
+    src.append("if (distance < best_distance) {");
+  }
+  src.push_indentation();
+  src.append("best = v;");
+  src.append("best_distance = distance;");
+  src.pop_indentation();
+  src.append("}");
+  src.pop_indentation();
+  src.append("}");
+  src.append("return best;");
+
+  src.pop_indentation();
+  src.append("}");
+}
+
+/// Switches over the selected variant and forwards the arguments to
+/// <function_name>_v<i>.
+static void forward_to_variant(SourceWriter &src, const SymbolicIR &symbolic_ir,
+                               std::size_t variant_count,
+                               std::string_view function_name,
+                               const std::vector<std::string> &args) {
+  src.append(fmt::format("switch (denox_select_variant({})) {{",
+                         join(symbolic_ir.vars)));
+  for (std::size_t v = 0; v < variant_count; ++v) {
+    src.append(v + 1 == variant_count ? "default:"
+                                      : fmt::format("case {}:", v));
+    src.push_indentation();
+    src.append(fmt::format("{}_v{}({});", function_name, v, join(args)));
+    src.append("break;");
+    src.pop_indentation();
+  }
+  src.append("}");
+}
+
+} // namespace vkdt_denox
+
+bool vkdt_denox::requires_cooperative_matrix(const denox::dnx::Model *dnx) {
+  const auto *features = dnx->required_features();
+  if (features == nullptr) {
+    return false;
+  }
+  for (uint32_t i = 0; i < features->size(); ++i) {
+    if (features->Get(i) == denox::dnx::RuntimeFeature_CooperativeMatrix) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void vkdt_denox::def_func_denox_variants(
+    SourceWriter &src, const SymbolicIR &symbolic_ir,
+    const ComputeGraph &compute_graph, std::span<const VariantTarget> targets) {
+  src.add_include("stdint.h", IncludeType::System);
+  src.add_include("modules/api.h", IncludeType::Local);
+
+  if (symbolic_ir.vars.empty()) {
+    throw std::runtime_error(
+        "variants require a model with dynamic extents to select from.");
+  }
+  for (const auto &target : targets) {
+    if (!target.extents.empty() &&
+        target.extents.size() != symbolic_ir.vars.size()) {
+      throw std::runtime_error("variant target does not specify every extent.");
+    }
+  }
+  if (std::ranges::all_of(targets, &VariantTarget::cooperative_matrix)) {
+    fmt::println(stderr, "Warning: every variant requires cooperative "
+                         "matrices, the module will fail on devices without "
+                         "VK_KHR_cooperative_matrix.");
+  }
+  if (std::ranges::any_of(targets, &VariantTarget::cooperative_matrix)) {
+    src.add_include("qvk/qvk.h", IncludeType::Local);
+    // Modules may override the check, e.g. to test the fallback.
+    src.append("#ifndef DENOX_COOPMAT_SUPPORTED");
+    src.append("#define DENOX_COOPMAT_SUPPORTED (qvk.coopmat_supported)");
+    src.append("#endif");
+    src.append("\n");
+  }
+
+  def_func_denox_select_variant(src, symbolic_ir, targets);
+  src.append("\n");
+
+  std::vector<std::string> args = {"graph", "module"};
+  args.insert(args.end(), symbolic_ir.vars.begin(), symbolic_ir.vars.end());
+  src.append("static void denox_create_nodes(dt_graph_t* graph, "
+             "dt_module_t* module,");
+  src.push_indentation(3);
+  std::vector<std::string> params;
+  for (const auto &var : symbolic_ir.vars) {
+    params.push_back(fmt::format("uint64_t {}", var));
+  }
+  src.append(join(params) + ",");
+  std::vector<const InOutDescriptor *> connectors;
+  for (const auto &input : compute_graph.input_descriptors) {
+    connectors.push_back(&input);
+  }
+  for (const auto &output : compute_graph.output_descriptors) {
+    connectors.push_back(&output);
+  }
+  assert(!connectors.empty());
+  for (std::size_t i = 0; i < connectors.size(); ++i) {
+    const std::string &name = connectors[i]->name;
+    src.append(fmt::format("int {}_id, const char* {}_connector{}", name, name,
+                           i + 1 == connectors.size() ? ") {" : ","));
+    args.push_back(fmt::format("{}_id", name));
+    args.push_back(fmt::format("{}_connector", name));
+  }
+  src.pop_indentation(3);
+  src.push_indentation();
+  forward_to_variant(src, symbolic_ir, targets.size(), "denox_create_nodes",
+                     args);
+  src.pop_indentation();
+  src.append("}");
+  src.append("\n");
+
+  src.append(fmt::format(
+      "static inline void denox_query_cost({}, denox_cost_t* cost) {{",
+      join(params)));
+  src.push_indentation();
+  args = symbolic_ir.vars;
+  args.push_back("cost");
+  forward_to_variant(src, symbolic_ir, targets.size(), "denox_query_cost",
+                     args);
+  src.pop_indentation();
+  src.append("}");
+}
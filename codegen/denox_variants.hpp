@@ -0,0 +1,33 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include "source_writer.hpp"
+#include "symbolics.hpp"
+#include <cstdint>
+#include <dnx.h>
+#include <span>
+#include <vector>
+namespace vkdt_denox {
+
+/// Resolution a variant was optimized for by denox (--optimize-for) and the
+/// device features it requires.
+struct VariantTarget {
+  // One extent per variable, in the order of SymbolicIR::vars. Empty for
+  // variants, which are only selected by their features.
+  std::vector<uint64_t> extents;
+  bool cooperative_matrix = false;
+};
+
+/// Whether the model lists RuntimeFeature_CooperativeMatrix in its required
+/// features.
+bool requires_cooperative_matrix(const denox::dnx::Model *dnx);
+
+/// Defines denox_select_variant, which picks the variant, whose target is
+/// closest to the actual extents, among the variants supported by the device,
+/// as well as denox_create_nodes and denox_query_cost, which forward to
+/// denox_create_nodes_v<i> and denox_query_cost_v<i> of the selected variant.
+void def_func_denox_variants(SourceWriter &src, const SymbolicIR &symbolic_ir,
+                             const ComputeGraph &compute_graph,
+                             std::span<const VariantTarget> targets);
+
+} // namespace vkdt_denox
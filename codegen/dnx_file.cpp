@@ -0,0 +1,36 @@
+#include "dnx_file.hpp"
+#include <flatbuffers/flatbuffers.h>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <utility>
+
+// Bounds of the verification, far above what denox emits.
+static constexpr flatbuffers::uoffset_t DNX_VERIFY_MAX_DEPTH = 64;
+static constexpr flatbuffers::uoffset_t DNX_VERIFY_MAX_TABLES = 1u << 24;
+
+vkdt_denox::DnxFile
+vkdt_denox::read_dnx_file(const std::filesystem::path &path, bool verify) {
+  MappedFile file(path.string());
+  if (verify) {
+    if (file.size() >= FLATBUFFERS_MAX_BUFFER_SIZE) {
+      throw std::runtime_error(fmt::format(
+          "{} is too large to be verified ({} bytes).", path.string(),
+          file.size()));
+    }
+    flatbuffers::Verifier verifier(file.data(), file.size(),
+                                   DNX_VERIFY_MAX_DEPTH,
+                                   DNX_VERIFY_MAX_TABLES);
+    if (!denox::dnx::VerifyModelBuffer(verifier)) {
+      throw std::runtime_error(
+          fmt::format("{} is not a valid dnx artifact.", path.string()));
+    }
+  } else if (file.size() < 2 * sizeof(flatbuffers::uoffset_t)) {
+    throw std::runtime_error(
+        fmt::format("{} is not a valid dnx artifact.", path.string()));
+  }
+  const denox::dnx::Model *model = denox::dnx::GetModel(file.data());
+  return DnxFile{
+      .file = std::move(file),
+      .model = model,
+  };
+}
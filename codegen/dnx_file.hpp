@@ -0,0 +1,23 @@
+#pragma once
+
+#include "io.hpp"
+#include <dnx.h>
+#include <filesystem>
+namespace vkdt_denox {
+
+/// A .dnx artifact mapped into memory. The model, as well as everything
+/// borrowed from it (e.g. the spans of shader binaries and the initializers
+/// copied by compress_weights), points into the mapping and is only valid as
+/// long as the DnxFile lives.
+struct DnxFile {
+  MappedFile file;
+  const denox::dnx::Model *model;
+};
+
+/// Maps the .dnx at the given path. With verify, the flatbuffer is checked
+/// before it is used (identifier, offsets, vector bounds, nesting depth and
+/// table count). The verification never touches the content of byte vectors,
+/// such that the weights are not read from disk.
+DnxFile read_dnx_file(const std::filesystem::path &path, bool verify = false);
+
+} // namespace vkdt_denox
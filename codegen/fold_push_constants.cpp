@@ -0,0 +1,222 @@
+#include "fold_push_constants.hpp"
+#include "spirv.hpp"
+#include "symbolics.hpp"
+#include <map>
+#include <tuple>
+#include <variant>
+
+namespace vkdt_denox {
+
+static uint32_t push_constant_type_width(PushConstantType type) {
+  switch (type) {
+  case PushConstantType::U16:
+  case PushConstantType::I16:
+    return 16;
+  case PushConstantType::U32:
+  case PushConstantType::I32:
+    return 32;
+  case PushConstantType::U64:
+  case PushConstantType::I64:
+    return 64;
+  }
+  throw std::runtime_error("unreachable");
+}
+
+namespace {
+
+struct PushConstantMember {
+  uint32_t index;
+  uint32_t type;
+  uint32_t width;
+};
+
+// (offset, width, value) of a literal push constant field.
+using LiteralField = std::tuple<uint16_t, uint32_t, uint64_t>;
+
+} // namespace
+
+/// Maps byte offsets of the push constant block to its integer members.
+static std::map<uint32_t, PushConstantMember>
+push_constant_members(const spirv::Module &module, uint32_t variable) {
+  std::map<uint32_t, PushConstantMember> members;
+  const spirv::Definitions definitions = spirv::definitions(module);
+  const spirv::Instruction *var = spirv::find_definition(definitions, variable);
+  if (var == nullptr || var->opcode() != spirv::OpVariable) {
+    return members;
+  }
+  const spirv::Instruction *ptr =
+      spirv::find_definition(definitions, var->words[1]);
+  if (ptr == nullptr || ptr->opcode() != spirv::OpTypePointer) {
+    return members;
+  }
+  const uint32_t block = ptr->words[3];
+  const spirv::Instruction *block_type =
+      spirv::find_definition(definitions, block);
+  if (block_type == nullptr || block_type->opcode() != spirv::OpTypeStruct) {
+    return members;
+  }
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpMemberDecorate || inst.words[1] != block ||
+        inst.words[3] != spirv::DecorationOffset) {
+      continue;
+    }
+    const uint32_t index = inst.words[2];
+    // A member, which the struct does not declare, is malformed, such that
+    // the binary is left untouched.
+    if (index >= block_type->words.size() - 2) {
+      return {};
+    }
+    const uint32_t type = block_type->words[2 + index];
+    const spirv::Instruction *member_type =
+        spirv::find_definition(definitions, type);
+    if (member_type == nullptr || member_type->opcode() != spirv::OpTypeInt) {
+      continue;
+    }
+    members.emplace(inst.words[4], PushConstantMember{
+                                       .index = index,
+                                       .type = type,
+                                       .width = member_type->words[2],
+                                   });
+  }
+  return members;
+}
+
+/// Replaces loads of the given push constant members by constants.
+static uint32_t fold_members(spirv::Module &module, uint32_t variable,
+                             const std::map<uint32_t, PushConstantMember> &pc,
+                             const std::vector<LiteralField> &literals) {
+  // member index -> constant id
+  std::map<uint32_t, uint32_t> constants;
+  for (const auto &[offset, width, value] : literals) {
+    auto it = pc.find(offset);
+    if (it == pc.end() || it->second.width != width) {
+      continue;
+    }
+    constants[it->second.index] =
+        spirv::find_or_add_constant(module, it->second.type, value);
+  }
+  if (constants.empty()) {
+    return 0;
+  }
+
+  // Indexed after the constants are added, which invalidates the pointers.
+  const spirv::Definitions definitions = spirv::definitions(module);
+  // access chain id -> constant id
+  std::map<uint32_t, uint32_t> chains;
+  for (const auto &inst : module.instructions) {
+    const auto op = inst.opcode();
+    if ((op != spirv::OpAccessChain && op != spirv::OpInBoundsAccessChain) ||
+        inst.words.size() != 5 || inst.words[3] != variable) {
+      continue;
+    }
+    auto index = spirv::constant_value(definitions, inst.words[4]);
+    if (!index.has_value()) {
+      continue;
+    }
+    auto it = constants.find(static_cast<uint32_t>(*index));
+    if (it != constants.end()) {
+      chains.emplace(inst.words[2], it->second);
+    }
+  }
+
+  // The literal is still pushed, therefore other accesses of the member
+  // remain valid and only plain loads have to be rewritten.
+  uint32_t folded = 0;
+  for (auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpLoad) {
+      continue;
+    }
+    auto it = chains.find(inst.words[3]);
+    if (it == chains.end()) {
+      continue;
+    }
+    inst = spirv::make_instruction(spirv::OpCopyObject,
+                                   {inst.words[1], inst.words[2], it->second});
+    ++folded;
+  }
+  return folded;
+}
+
+} // namespace vkdt_denox
+
+vkdt_denox::PushConstantFolding vkdt_denox::fold_literal_push_constants(
+    ComputeGraph &compute_graph, ShaderRegistry &shader_registry,
+    std::size_t byte_budget) {
+  PushConstantFolding result;
+
+  // binary id -> literal fields -> dispatch nodes
+  std::map<uint32_t, std::map<std::vector<LiteralField>, std::vector<uint32_t>>>
+      binaries;
+  for (uint32_t nid = 0; nid < compute_graph.nodes.size(); ++nid) {
+    const auto &node = compute_graph.nodes[nid];
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    const auto &dispatch = std::get<ComputeDispatch>(node.op);
+    std::vector<LiteralField> literals;
+    for (const auto &field : dispatch.pc.fields) {
+      if (field.value.type != denox::dnx::ScalarSource_literal) {
+        continue;
+      }
+      literals.emplace_back(
+          field.offset, push_constant_type_width(field.type),
+          read_unsigned_scalar_literal(
+              static_cast<const denox::dnx::ScalarLiteral *>(
+                  field.value.ptr)) +
+              field.addend);
+    }
+    std::ranges::sort(literals);
+    binaries[dispatch.binary_id][std::move(literals)].push_back(nid);
+  }
+
+  for (const auto &[binary_id, variants] : binaries) {
+    const auto spv = shader_registry.binaries[binary_id].spv;
+    const spirv::Module module = spirv::parse(spv);
+    const auto variable = spirv::push_constant_variable(module);
+    if (!variable.has_value()) {
+      continue;
+    }
+    const auto pc = push_constant_members(module, *variable);
+
+    // The original binary is only dropped, if all dispatches are specialized.
+    std::size_t variant_count = 0;
+    bool keeps_original = false;
+    for (const auto &[literals, _] : variants) {
+      if (literals.empty()) {
+        keeps_original = true;
+      } else {
+        ++variant_count;
+      }
+    }
+    if (variant_count == 0) {
+      continue;
+    }
+    const std::size_t cost =
+        (keeps_original ? variant_count : variant_count - 1) * spv.size_bytes();
+    if (result.variant_bytes + cost > byte_budget) {
+      continue;
+    }
+
+    for (const auto &[literals, nodes] : variants) {
+      if (literals.empty()) {
+        continue;
+      }
+      spirv::Module variant = module;
+      const uint32_t folded = fold_members(variant, *variable, pc, literals);
+      if (folded == 0) {
+        continue;
+      }
+      result.folded_loads += folded;
+      result.variants += 1;
+      const uint32_t id =
+          register_shader_binary(shader_registry, spirv::assemble(variant));
+      for (uint32_t nid : nodes) {
+        std::get<ComputeDispatch>(compute_graph.nodes[nid].op).binary_id = id;
+      }
+    }
+    result.variant_bytes += cost;
+  }
+
+  prune_shader_registry(shader_registry, compute_graph);
+  return result;
+}
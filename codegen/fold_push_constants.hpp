@@ -0,0 +1,24 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include "shader_registry.hpp"
+#include <cstddef>
+#include <cstdint>
+namespace vkdt_denox {
+
+struct PushConstantFolding {
+  uint32_t folded_loads = 0;
+  uint32_t variants = 0;
+  // SPIR-V bytes which the variants add on top of the original binaries.
+  std::size_t variant_bytes = 0;
+};
+
+/// Specializes shaders for the literal push constant fields of their
+/// dispatches. Loads of literal fields are replaced by constants, such that
+/// the driver can fold them. Dispatches with equal literals share a variant.
+/// Binaries whose variants would exceed the byte budget are left untouched.
+PushConstantFolding fold_literal_push_constants(ComputeGraph &compute_graph,
+                                                ShaderRegistry &shader_registry,
+                                                std::size_t byte_budget);
+
+} // namespace vkdt_denox
@@ -2,12 +2,19 @@
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
-static void atomic_write_raw(const std::string &path, const char *data,
-                             std::size_t size) {
+static void
+atomic_write_raw(const std::string &path,
+                 std::span<const std::span<const std::uint8_t>> chunks) {
   const std::filesystem::path fpath(path);
   const std::filesystem::path tmp = fpath.string() + ".tmp";
   {
@@ -17,10 +24,13 @@ static void atomic_write_raw(const std::string &path, const char *data,
                                tmp.string());
     }
 
-    file.write(data, static_cast<std::streamsize>(size));
-    if (!file) {
-      throw std::runtime_error("atomic_write: write failed for temp file: " +
-                               tmp.string());
+    for (const auto &chunk : chunks) {
+      file.write(reinterpret_cast<const char *>(chunk.data()),
+                 static_cast<std::streamsize>(chunk.size()));
+      if (!file) {
+        throw std::runtime_error(
+            "atomic_write: write failed for temp file: " + tmp.string());
+      }
     }
 
     file.flush();
@@ -40,11 +50,19 @@ static void atomic_write_raw(const std::string &path, const char *data,
 
 void vkdt_denox::write_file_bytes(const std::string &path, const void *buf,
                                   std::size_t size) {
-  atomic_write_raw(path, static_cast<const char *>(buf), size);
+  const std::span<const std::uint8_t> chunk(
+      static_cast<const std::uint8_t *>(buf), size);
+  atomic_write_raw(path, std::span(&chunk, 1));
 }
 
 void vkdt_denox::write_file(const std::string &path, const std::string &data) {
-  atomic_write_raw(path, data.data(), data.size());
+  write_file_bytes(path, data.data(), data.size());
+}
+
+void vkdt_denox::write_file_chunks(
+    const std::string &path,
+    std::span<const std::span<const std::uint8_t>> chunks) {
+  atomic_write_raw(path, chunks);
 }
 
 std::vector<std::uint8_t> vkdt_denox::read_file_bytes(const std::string &path) {
@@ -89,6 +107,54 @@ std::string vkdt_denox::read_file(const std::string &path) {
   return s;
 }
 
+vkdt_denox::MappedFile::MappedFile(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("MappedFile: cannot open " + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("MappedFile: fstat failed " + path);
+  }
+  m_size = static_cast<std::size_t>(st.st_size);
+  if (m_size == 0) {
+    // mmap rejects empty mappings.
+    ::close(fd);
+    return;
+  }
+  void *ptr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED) {
+    throw std::runtime_error("MappedFile: mmap failed " + path + ": " +
+                             std::strerror(errno));
+  }
+  m_data = static_cast<const std::uint8_t *>(ptr);
+}
+
+vkdt_denox::MappedFile::~MappedFile() {
+  if (m_data != nullptr) {
+    ::munmap(const_cast<std::uint8_t *>(m_data), m_size);
+  }
+}
+
+vkdt_denox::MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)) {}
+
+vkdt_denox::MappedFile &
+vkdt_denox::MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    if (m_data != nullptr) {
+      ::munmap(const_cast<std::uint8_t *>(m_data), m_size);
+    }
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+  }
+  return *this;
+}
+
 void vkdt_denox::mkdir(const std::filesystem::path &path) {
   if (std::filesystem::exists(path)) {
     if (!std::filesystem::is_directory(path)) {
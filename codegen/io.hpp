@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
 #include <vector>
 namespace vkdt_denox {
@@ -10,10 +11,36 @@ void write_file_bytes(const std::string &path, const void *buf, std::size_t size
 
 void write_file(const std::string &path, const std::string &data);
 
+/// Writes the concatenation of the chunks.
+void write_file_chunks(const std::string &path,
+                       std::span<const std::span<const std::uint8_t>> chunks);
+
 std::vector<std::uint8_t> read_file_bytes(const std::string &path);
 
 std::string read_file(const std::string &path);
 
+/// Read-only memory mapping of a file. Pages are only read from disk once
+/// they are accessed, such that large files (e.g. the weights of a .dnx) are
+/// not copied into memory up front.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const std::uint8_t *data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  std::span<const std::uint8_t> bytes() const { return {m_data, m_size}; }
+
+private:
+  const std::uint8_t *m_data = nullptr;
+  std::size_t m_size = 0;
+};
+
 void mkdir(const std::filesystem::path &path);
 
 } // namespace vkdt_denox
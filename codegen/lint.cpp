@@ -0,0 +1,292 @@
+#include "lint.hpp"
+#include "cost_manifest.hpp"
+#include "source_writer.hpp"
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+#include <map>
+#include <variant>
+
+namespace vkdt_denox {
+
+static constexpr std::array<std::string_view, 5> lint_checks = {
+    "low-occupancy", "weight-padding", "dummy-chain", "fusion-candidate",
+    "push-constant-memcpy",
+};
+
+static std::string node_name(const Node &node) {
+  if (std::holds_alternative<ComputeDispatch>(node.op)) {
+    return std::get<ComputeDispatch>(node.op).name;
+  }
+  return std::get<Upload>(node.op).name;
+}
+
+static bool is_dummy_connector(const ComputeGraph &compute_graph,
+                               const Connector &connector) {
+  return connector.src_node < compute_graph.nodes.size() &&
+         compute_graph.nodes[connector.src_node].dummy_source ==
+             connector.src_node_sinksource;
+}
+
+static void lint_occupancy(std::vector<LintFinding> &findings,
+                           const SymbolicIR &symbolic_ir,
+                           const ComputeGraph &compute_graph,
+                           const ShaderRegistry &shader_registry,
+                           std::span<const std::vector<int64_t>> resolutions,
+                           const LintOptions &options) {
+  for (std::size_t r = 0; r < resolutions.size(); ++r) {
+    for (const auto &cost : evaluate_dispatch_costs(
+             symbolic_ir, compute_graph, shader_registry, resolutions[r])) {
+      const int64_t workgroups = cost.workgroup_count[0] *
+                                 cost.workgroup_count[1] *
+                                 cost.workgroup_count[2];
+      if (workgroups >= static_cast<int64_t>(options.min_workgroups)) {
+        continue;
+      }
+      findings.push_back(LintFinding{
+          .check = "low-occupancy",
+          .node = cost.node,
+          .resolution = r,
+          .value = workgroups,
+          .message = fmt::format(
+              "{} launches {} workgroups ({}x{}x{}), fewer than the {} "
+              "required to fill the GPU",
+              cost.shader, workgroups, cost.workgroup_count[0],
+              cost.workgroup_count[1], cost.workgroup_count[2],
+              options.min_workgroups),
+      });
+    }
+  }
+}
+
+static void lint_weight_padding(std::vector<LintFinding> &findings,
+                                const CompressedWeights &compressed_weights,
+                                const LintOptions &options) {
+  if (compressed_weights.byte_size == 0) {
+    return;
+  }
+  const double ratio = static_cast<double>(compressed_weights.padding_bytes) /
+                       static_cast<double>(compressed_weights.byte_size);
+  if (ratio <= options.max_padding_ratio) {
+    return;
+  }
+  findings.push_back(LintFinding{
+      .check = "weight-padding",
+      .node = "",
+      .resolution = std::nullopt,
+      .value = static_cast<int64_t>(compressed_weights.padding_bytes),
+      .message = fmt::format(
+          "{} of {} bytes of the weight file ({:.1f}%) are alignment padding",
+          compressed_weights.padding_bytes, compressed_weights.byte_size,
+          ratio * 100.0),
+  });
+}
+
+/// Dummy connectors order a dispatch behind the readers of a buffer, which it
+/// overwrites. Chains of them serialize dispatches, which share no data.
+static void lint_dummy_chains(std::vector<LintFinding> &findings,
+                              const ComputeGraph &compute_graph) {
+  const std::size_t n = compute_graph.nodes.size();
+  // Length of the longest dummy chain ending at a node and its first node.
+  std::vector<uint32_t> depth(n, 0);
+  std::vector<uint32_t> start(n);
+  std::vector<bool> continued(n, false);
+  std::vector<std::vector<uint32_t>> predecessors(n);
+  for (const auto &connector : compute_graph.connectors) {
+    if (connector.dst_node < n &&
+        is_dummy_connector(compute_graph, connector)) {
+      predecessors[connector.dst_node].push_back(connector.src_node);
+      continued[connector.src_node] = true;
+    }
+  }
+  // Nodes are in dispatch order, predecessors precede their successors.
+  for (uint32_t nid = 0; nid < n; ++nid) {
+    start[nid] = nid;
+    for (uint32_t pred : predecessors[nid]) {
+      if (depth[pred] + 1 > depth[nid]) {
+        depth[nid] = depth[pred] + 1;
+        start[nid] = start[pred];
+      }
+    }
+  }
+  for (uint32_t nid = 0; nid < n; ++nid) {
+    if (depth[nid] == 0 || continued[nid]) {
+      continue;
+    }
+    findings.push_back(LintFinding{
+        .check = "dummy-chain",
+        .node = node_name(compute_graph.nodes[nid]),
+        .resolution = std::nullopt,
+        .value = depth[nid],
+        .message = fmt::format(
+            "ordered behind {} by a chain of {} dummy connectors, reusing "
+            "fewer buffers would let the dispatches overlap",
+            node_name(compute_graph.nodes[start[nid]]), depth[nid]),
+    });
+  }
+}
+
+static int64_t buffer_roi_bytes(const BufferRoi &roi,
+                                std::span<const int64_t> values) {
+  if (std::holds_alternative<uint64_t>(roi.byte_size)) {
+    return static_cast<int64_t>(std::get<uint64_t>(roi.byte_size));
+  }
+  return evaluate_symbol(values, std::get<Symbol>(roi.byte_size));
+}
+
+/// Buffers, which only the next dispatch reads, are round trips through
+/// memory, which a fused kernel would keep on chip.
+static void lint_fusion_candidates(
+    std::vector<LintFinding> &findings, const SymbolicIR &symbolic_ir,
+    const ComputeGraph &compute_graph,
+    std::span<const std::vector<int64_t>> resolutions) {
+  const std::size_t n = compute_graph.nodes.size();
+  // (node, sinksource) -> readers
+  std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> readers;
+  for (const auto &connector : compute_graph.connectors) {
+    if (connector.src_node < n &&
+        !is_dummy_connector(compute_graph, connector)) {
+      readers[{connector.src_node, connector.src_node_sinksource}].push_back(
+          connector.dst_node);
+    }
+  }
+  std::vector<std::vector<int64_t>> values;
+  for (const auto &vars : resolutions) {
+    values.push_back(evaluate_symbolic_ir(symbolic_ir, vars));
+  }
+
+  std::optional<uint32_t> next;
+  for (uint32_t nid = static_cast<uint32_t>(n); nid-- > 0;) {
+    const Node &node = compute_graph.nodes[nid];
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    for (uint32_t s = 0; s < node.sinksources.size() && next.has_value();
+         ++s) {
+      const SinkSource &sinksource = node.sinksources[s];
+      if (sinksource.type != SinkSourceType::Write) {
+        continue;
+      }
+      auto it = readers.find({nid, s});
+      if (it == readers.end() || it->second.size() != 1 ||
+          it->second.front() != *next) {
+        continue;
+      }
+      const BufferRoi &roi =
+          compute_graph.buffer_rois[sinksource.buffer_roi_id];
+      for (std::size_t r = 0; r < resolutions.size(); ++r) {
+        const int64_t bytes = buffer_roi_bytes(roi, values[r]);
+        findings.push_back(LintFinding{
+            .check = "fusion-candidate",
+            .node = node_name(node),
+            .resolution = r,
+            .value = bytes,
+            .message = fmt::format(
+                "connector {} ({} bytes) is only read by the next dispatch "
+                "{}, fusing both saves writing and reading it",
+                sinksource.name, bytes,
+                node_name(compute_graph.nodes[*next])),
+        });
+      }
+    }
+    next = nid;
+  }
+}
+
+static void lint_push_constants(std::vector<LintFinding> &findings,
+                                const ComputeGraph &compute_graph) {
+  for (const auto &node : compute_graph.nodes) {
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    const auto &dispatch = std::get<ComputeDispatch>(node.op);
+    if (dispatch.pc.size == 0 || is_contiguous_u32(dispatch.pc)) {
+      continue;
+    }
+    findings.push_back(LintFinding{
+        .check = "push-constant-memcpy",
+        .node = dispatch.name,
+        .resolution = std::nullopt,
+        .value = dispatch.pc.size,
+        .message = fmt::format(
+            "{} bytes of push constants in {} fields are not consecutive "
+            "uint32_t values and are assembled with memcpy",
+            dispatch.pc.size, dispatch.pc.fields.size()),
+    });
+  }
+}
+
+} // namespace vkdt_denox
+
+std::vector<vkdt_denox::LintFinding> vkdt_denox::lint_compute_graph(
+    const SymbolicIR &symbolic_ir, const ComputeGraph &compute_graph,
+    const CompressedWeights &compressed_weights,
+    const ShaderRegistry &shader_registry,
+    std::span<const std::vector<int64_t>> resolutions,
+    const LintOptions &options) {
+  std::vector<LintFinding> findings;
+  lint_occupancy(findings, symbolic_ir, compute_graph, shader_registry,
+                 resolutions, options);
+  lint_weight_padding(findings, compressed_weights, options);
+  lint_dummy_chains(findings, compute_graph);
+  lint_fusion_candidates(findings, symbolic_ir, compute_graph, resolutions);
+  lint_push_constants(findings, compute_graph);
+  return findings;
+}
+
+std::string vkdt_denox::create_lint_report(
+    const SymbolicIR &symbolic_ir,
+    std::span<const std::vector<int64_t>> resolutions,
+    std::span<const LintFinding> findings) {
+  SourceWriter src;
+  src.append("{");
+  src.push_indentation();
+
+  src.append("\"resolutions\": [");
+  src.push_indentation();
+  for (std::size_t r = 0; r < resolutions.size(); ++r) {
+    std::string resolution = "{";
+    for (std::size_t v = 0; v < symbolic_ir.vars.size(); ++v) {
+      resolution.append(fmt::format("{}{}: {}", v == 0 ? "" : ", ",
+                                    json_string(symbolic_ir.vars[v]),
+                                    resolutions[r][v]));
+    }
+    resolution.append(r + 1 == resolutions.size() ? "}" : "},");
+    src.append(resolution);
+  }
+  src.pop_indentation();
+  src.append("],");
+
+  src.append("\"summary\": {");
+  src.push_indentation();
+  for (std::size_t c = 0; c < lint_checks.size(); ++c) {
+    const auto count = std::ranges::count_if(findings, [&](const auto &f) {
+      return f.check == lint_checks[c];
+    });
+    src.append(fmt::format("{}: {}{}", json_string(lint_checks[c]), count,
+                           c + 1 == lint_checks.size() ? "" : ","));
+  }
+  src.pop_indentation();
+  src.append("},");
+
+  src.append("\"findings\": [");
+  src.push_indentation();
+  for (std::size_t i = 0; i < findings.size(); ++i) {
+    const LintFinding &finding = findings[i];
+    src.append(fmt::format(
+        "{{\"check\": {}, \"node\": {}, \"resolution\": {}, \"value\": {}, "
+        "\"message\": {}}}{}",
+        json_string(finding.check),
+        finding.node.empty() ? "null" : json_string(finding.node),
+        finding.resolution.has_value() ? fmt::format("{}", *finding.resolution)
+                                       : "null",
+        finding.value, json_string(finding.message),
+        i + 1 == findings.size() ? "" : ","));
+  }
+  src.pop_indentation();
+  src.append("]");
+
+  src.pop_indentation();
+  src.append("}");
+  return src.finish();
+}
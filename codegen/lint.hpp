@@ -0,0 +1,61 @@
+#pragma once
+
+#include "compress_weights.hpp"
+#include "compute_graph.hpp"
+#include "shader_registry.hpp"
+#include "symbolics.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+namespace vkdt_denox {
+
+struct LintOptions {
+  // Workgroups, which a dispatch needs to fill the GPU (e.g. a few per
+  // compute unit).
+  uint64_t min_workgroups = 256;
+  // Share of the weight file, which alignment padding may take.
+  double max_padding_ratio = 0.05;
+};
+
+struct LintFinding {
+  // Name of the check, e.g. "low-occupancy".
+  std::string check;
+  // Node the finding refers to, empty for findings about the whole model.
+  std::string node;
+  // Index of the resolution, for findings which depend on the extents.
+  std::optional<std::size_t> resolution;
+  // Measured quantity of the check, e.g. the workgroup count.
+  int64_t value;
+  std::string message;
+};
+
+/// Checks the compute graph for patterns, which make the generated module
+/// slower than necessary:
+/// - "low-occupancy": dispatches with fewer than min_workgroups workgroups.
+/// - "weight-padding": alignment padding beyond max_padding_ratio of the
+///   weight file.
+/// - "dummy-chain": dispatches ordered behind others by dummy connectors.
+/// - "fusion-candidate": buffers, which a dispatch writes and only the next
+///   dispatch reads.
+/// - "push-constant-memcpy": push constants, which are not consecutive
+///   uint32_t values and are therefore assembled with memcpy.
+/// Extent dependent checks are evaluated for every resolution, which holds
+/// the values of the variables of the symbolic IR.
+std::vector<LintFinding>
+lint_compute_graph(const SymbolicIR &symbolic_ir,
+                   const ComputeGraph &compute_graph,
+                   const CompressedWeights &compressed_weights,
+                   const ShaderRegistry &shader_registry,
+                   std::span<const std::vector<int64_t>> resolutions,
+                   const LintOptions &options);
+
+/// JSON report of the findings, including the evaluated resolutions and the
+/// number of findings per check.
+std::string
+create_lint_report(const SymbolicIR &symbolic_ir,
+                   std::span<const std::vector<int64_t>> resolutions,
+                   std::span<const LintFinding> findings);
+
+} // namespace vkdt_denox
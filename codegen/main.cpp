@@ -26,7 +26,8 @@ int main() {
   vkdt_denox::ShaderRegistry shader_registry =
       vkdt_denox::create_shader_registry(dnx);
   vkdt_denox::ComputeGraph compute_graph =
-      vkdt_denox::reconstruct_compute_graph(dnx, compressed_weights);
+      vkdt_denox::reconstruct_compute_graph(dnx, compressed_weights,
+                                            shader_registry);
 
   std::string module_name = "denox";
 
@@ -40,8 +41,7 @@ int main() {
   // // // 1. Write compressed weights to disk.
 
   std::filesystem::path weights_path = module_dir / "weights.bin";
-  vkdt_denox::write_file_bytes(weights_path, compressed_weights.data.data(),
-                               compressed_weights.data.size());
+  vkdt_denox::write_file_chunks(weights_path, compressed_weights.chunks);
   for (const auto &binary : shader_registry.binaries) {
     vkdt_denox::write_file_bytes(module_dir / (binary.name + ".comp.spv"),
                                  binary.spv.data(),
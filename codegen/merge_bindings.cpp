@@ -0,0 +1,512 @@
+#include "merge_bindings.hpp"
+#include "spirv.hpp"
+#include "symbolics.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <fmt/base.h>
+#include <limits>
+#include <map>
+#include <set>
+#include <variant>
+
+namespace vkdt_denox {
+
+namespace {
+
+/// Read bindings of a dispatch, which are connected to the same source. The
+/// first binding of a group is bound in place of the others.
+using BindingGroups = std::vector<std::vector<uint32_t>>;
+
+struct BufferVariable {
+  uint32_t variable;
+  // ArrayStride of the runtime array wrapped by the buffer block.
+  uint32_t stride;
+};
+
+} // namespace
+
+// vkdt binds the connectors of a node to descriptor set 1.
+static constexpr uint32_t connector_set = 1;
+// Minimum maxPushConstantsSize guaranteed by Vulkan.
+static constexpr uint32_t max_push_constant_size = 128;
+
+static BindingGroups binding_groups(const ComputeGraph &compute_graph,
+                                    uint32_t nid,
+                                    const std::vector<uint32_t> &incoming) {
+  const Node &node = compute_graph.nodes[nid];
+  // (source node, source sinksource) -> sinksources of the node.
+  std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> sources;
+  for (uint32_t c : incoming) {
+    const Connector &connector = compute_graph.connectors[c];
+    if (connector.src_node_sinksource == none_sentinal) {
+      continue;
+    }
+    const SinkSource &sinksource =
+        node.sinksources[connector.dst_node_sinksource];
+    // Dummy sinks only order the dispatches, the shader does not bind them.
+    if (sinksource.type != SinkSourceType::Read ||
+        !sinksource.tensor_offset.has_value()) {
+      continue;
+    }
+    sources[{connector.src_node, connector.src_node_sinksource}].push_back(
+        connector.dst_node_sinksource);
+  }
+  BindingGroups groups;
+  for (auto &[_, bindings] : sources) {
+    if (bindings.size() < 2) {
+      continue;
+    }
+    std::ranges::sort(bindings);
+    groups.push_back(std::move(bindings));
+  }
+  std::ranges::sort(groups);
+  return groups;
+}
+
+/// Whether the binding is bound through the first binding of its group.
+static bool is_merged(const BindingGroups &groups, uint32_t index) {
+  return std::ranges::any_of(groups, [&](const auto &group) {
+    return std::find(group.begin() + 1, group.end(), index) != group.end();
+  });
+}
+
+/// Index of a sinksource or binding, once the merged ones are removed.
+static uint32_t merged_index(const BindingGroups &groups, uint32_t index) {
+  for (const auto &group : groups) {
+    if (std::find(group.begin() + 1, group.end(), index) != group.end()) {
+      index = group.front();
+    }
+  }
+  uint32_t removed = 0;
+  for (const auto &group : groups) {
+    removed += static_cast<uint32_t>(std::count_if(
+        group.begin() + 1, group.end(), [&](uint32_t b) { return b < index; }));
+  }
+  return index - removed;
+}
+
+/// ArrayStride of the storage buffer block, which the variable points to, if
+/// the block only consists of a runtime array.
+static std::optional<uint32_t>
+runtime_array_stride(const spirv::Module &module,
+                     const spirv::Definitions &definitions, uint32_t variable) {
+  const auto *var = spirv::find_definition(definitions, variable);
+  if (var == nullptr || var->opcode() != spirv::OpVariable) {
+    return std::nullopt;
+  }
+  const auto *ptr = spirv::find_definition(definitions, var->words[1]);
+  if (ptr == nullptr || ptr->opcode() != spirv::OpTypePointer) {
+    return std::nullopt;
+  }
+  const uint32_t storage_class = ptr->words[2];
+  const auto *block = spirv::find_definition(definitions, ptr->words[3]);
+  if (block == nullptr || block->opcode() != spirv::OpTypeStruct ||
+      block->words.size() != 3) {
+    return std::nullopt;
+  }
+  const auto *array = spirv::find_definition(definitions, block->words[2]);
+  if (array == nullptr || array->opcode() != spirv::OpTypeRuntimeArray) {
+    return std::nullopt;
+  }
+  bool buffer_block = false;
+  std::optional<uint32_t> stride;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpDecorate) {
+      continue;
+    }
+    if (inst.words[1] == block->words[1] &&
+        inst.words[2] == spirv::DecorationBufferBlock) {
+      buffer_block = true;
+    } else if (inst.words[1] == array->words[1] &&
+               inst.words[2] == spirv::DecorationArrayStride) {
+      stride = inst.words[3];
+    }
+  }
+  // Uniform blocks are bound as uniform buffers, which cannot alias the
+  // storage buffer of their group.
+  if (storage_class != spirv::StorageClassStorageBuffer &&
+      !(storage_class == spirv::StorageClassUniform && buffer_block)) {
+    return std::nullopt;
+  }
+  // Offsets of descriptors are aligned to minStorageBufferOffsetAlignment,
+  // which makes them multiples of the strides up to 16.
+  if (!stride.has_value() || !std::has_single_bit(*stride) || *stride > 16) {
+    return std::nullopt;
+  }
+  return stride;
+}
+
+/// Result id -> result type of all instructions with a result type.
+static std::map<uint32_t, uint32_t> result_types(const spirv::Module &module) {
+  std::map<uint32_t, uint32_t> types;
+  for (const auto &inst : module.instructions) {
+    const auto layout = spirv::result_layout(inst.opcode());
+    if (layout.type.has_value() && layout.result.has_value() &&
+        *layout.result < inst.words.size()) {
+      types.emplace(inst.words[*layout.result], inst.words[*layout.type]);
+    }
+  }
+  return types;
+}
+
+static bool is_32bit_index(const spirv::Definitions &definitions,
+                           const std::map<uint32_t, uint32_t> &types,
+                           uint32_t index) {
+  auto it = types.find(index);
+  if (it == types.end()) {
+    return false;
+  }
+  const auto *type = spirv::find_definition(definitions, it->second);
+  return type != nullptr && type->opcode() == spirv::OpTypeInt &&
+         type->words[2] == 32;
+}
+
+/// Variables of the merged bindings by binding. Returns std::nullopt, if an
+/// access into one of them cannot be offset, only access chains into the
+/// runtime array of a storage buffer block with 32-bit indices are rewritten.
+static std::optional<std::map<uint32_t, std::vector<BufferVariable>>>
+merged_variables(const spirv::Module &module, const BindingGroups &groups) {
+  std::map<uint32_t, uint32_t> sets;
+  std::map<uint32_t, uint32_t> bindings;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpDecorate) {
+      continue;
+    }
+    if (inst.words[2] == spirv::DecorationDescriptorSet) {
+      sets.emplace(inst.words[1], inst.words[3]);
+    } else if (inst.words[2] == spirv::DecorationBinding) {
+      bindings.emplace(inst.words[1], inst.words[3]);
+    }
+  }
+
+  std::map<uint32_t, std::vector<BufferVariable>> variables;
+  for (const auto &group : groups) {
+    for (uint32_t binding : group) {
+      variables[binding];
+    }
+  }
+  const spirv::Definitions definitions = spirv::definitions(module);
+  std::map<uint32_t, uint32_t> binding_of;
+  for (const auto &[variable, binding] : bindings) {
+    auto set = sets.find(variable);
+    if (set == sets.end() || set->second != connector_set ||
+        !variables.contains(binding)) {
+      continue;
+    }
+    const auto stride = runtime_array_stride(module, definitions, variable);
+    if (!stride.has_value()) {
+      return std::nullopt;
+    }
+    variables[binding].push_back(
+        BufferVariable{.variable = variable, .stride = *stride});
+    binding_of.emplace(variable, binding);
+  }
+
+  const auto types = result_types(module);
+  for (std::size_t i = spirv::function_section_begin(module);
+       i < module.instructions.size(); ++i) {
+    const auto &inst = module.instructions[i];
+    const auto op = inst.opcode();
+    for (std::size_t w = 1; w < inst.words.size(); ++w) {
+      if (!binding_of.contains(inst.words[w])) {
+        continue;
+      }
+      const bool indexed = (op == spirv::OpAccessChain ||
+                            op == spirv::OpInBoundsAccessChain) &&
+                           w == 3 && inst.words.size() >= 6;
+      if (!indexed || !is_32bit_index(definitions, types, inst.words[5])) {
+        return std::nullopt;
+      }
+    }
+  }
+  return variables;
+}
+
+/// Byte offsets, which the dispatches pass for the merged bindings, have to
+/// address whole elements of every variable bound to them.
+/// Symbolic offsets cannot be checked and are only accepted for variables
+/// with a stride of one byte.
+static bool offsets_aligned(
+    const ComputeGraph &compute_graph, const std::vector<uint32_t> &nodes,
+    const std::map<uint32_t, std::vector<BufferVariable>> &variables) {
+  for (uint32_t nid : nodes) {
+    const Node &node = compute_graph.nodes[nid];
+    for (const auto &[binding, buffers] : variables) {
+      const SinkSource &sinksource = node.sinksources[binding];
+      uint64_t offset = sinksource.buffer_ssbo_offset;
+      const bool literal =
+          sinksource.tensor_offset->type == denox::dnx::ScalarSource_literal;
+      if (literal) {
+        offset += read_unsigned_scalar_literal(
+            static_cast<const denox::dnx::ScalarLiteral *>(
+                sinksource.tensor_offset->ptr));
+      }
+      if (offset > std::numeric_limits<uint32_t>::max()) {
+        return false;
+      }
+      for (const auto &buffer : buffers) {
+        // The alignment of symbolic offsets is unknown, the division by the
+        // stride would truncate them.
+        if (offset % buffer.stride != 0 || (!literal && buffer.stride > 1)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/// Rewrites the shader, such that the merged bindings alias the first binding
+/// of their group and the bindings of set 1 stay linear. Every access chain
+/// into them adds the byte offset of its binding, which is read from the push
+/// constants at pc_offset, divided by the stride to the array index.
+static bool offset_accesses(
+    spirv::Module &module, const BindingGroups &groups,
+    const std::map<uint32_t, std::vector<BufferVariable>> &variables,
+    uint32_t pc_offset) {
+  const uint32_t uint_type =
+      spirv::find_or_add_type(module, spirv::OpTypeInt, {32, 0});
+
+  struct Offset {
+    uint32_t member;
+    // Constant id of the stride, 0 if the offset is not divided.
+    uint32_t stride;
+  };
+  // variable -> push constant holding its offset.
+  std::map<uint32_t, Offset> offsets;
+  uint32_t pc_variable = 0;
+  std::vector<uint32_t> interface;
+  uint32_t member = 0;
+  for (const auto &group : groups) {
+    for (uint32_t binding : group) {
+      const auto pc = spirv::append_push_constant_member(
+          module, uint_type, pc_offset + member++ * sizeof(uint32_t));
+      if (!pc.has_value()) {
+        return false;
+      }
+      pc_variable = pc->variable;
+      if (pc->declared_variable && module.header[1] >= 0x00010400) {
+        interface.push_back(pc_variable);
+      }
+      const uint32_t c_member =
+          spirv::find_or_add_constant(module, uint_type, pc->member);
+      for (const auto &buffer : variables.at(binding)) {
+        offsets.emplace(buffer.variable,
+                        Offset{.member = c_member,
+                               .stride = buffer.stride == 1
+                                             ? 0
+                                             : spirv::find_or_add_constant(
+                                                   module, uint_type,
+                                                   buffer.stride)});
+      }
+    }
+  }
+  const uint32_t pc_pointer = spirv::find_or_add_type(
+      module, spirv::OpTypePointer,
+      {spirv::StorageClassPushConstant, uint_type});
+
+  std::set<uint32_t> connector_variables;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() == spirv::OpDecorate &&
+        inst.words[2] == spirv::DecorationDescriptorSet &&
+        inst.words[3] == connector_set) {
+      connector_variables.insert(inst.words[1]);
+    }
+  }
+
+  const auto types = result_types(module);
+  const std::size_t begin = spirv::function_section_begin(module);
+  std::vector<spirv::Instruction> instructions;
+  instructions.reserve(module.instructions.size());
+  auto emit = [&](spirv::Op op, uint32_t type,
+                  std::initializer_list<uint32_t> operands) {
+    const uint32_t id = module.allocate_id();
+    spirv::Instruction inst = spirv::make_instruction(op, {type, id});
+    inst.words.insert(inst.words.end(), operands.begin(), operands.end());
+    inst.words[0] = (static_cast<uint32_t>(inst.words.size()) << 16) | op;
+    instructions.push_back(std::move(inst));
+    return id;
+  };
+  for (std::size_t i = 0; i < module.instructions.size(); ++i) {
+    auto &inst = module.instructions[i];
+    const auto op = inst.opcode();
+    if (op == spirv::OpEntryPoint && !interface.empty()) {
+      inst.words.insert(inst.words.end(), interface.begin(), interface.end());
+      inst.words[0] = (static_cast<uint32_t>(inst.words.size()) << 16) | op;
+    } else if (i >= begin && (op == spirv::OpAccessChain ||
+                              op == spirv::OpInBoundsAccessChain)) {
+      auto it = offsets.find(inst.words[3]);
+      if (it != offsets.end()) {
+        const uint32_t index = inst.words[5];
+        const uint32_t ptr =
+            emit(spirv::OpAccessChain, pc_pointer,
+                 {pc_variable, it->second.member});
+        uint32_t offset = emit(spirv::OpLoad, uint_type, {ptr});
+        if (it->second.stride != 0) {
+          offset =
+              emit(spirv::OpUDiv, uint_type, {offset, it->second.stride});
+        }
+        inst.words[5] =
+            emit(spirv::OpIAdd, types.at(index), {index, offset});
+      }
+    } else if (op == spirv::OpDecorate &&
+               inst.words[2] == spirv::DecorationBinding &&
+               connector_variables.contains(inst.words[1])) {
+      inst.words[3] = merged_index(groups, inst.words[3]);
+    }
+    instructions.push_back(std::move(inst));
+  }
+  module.instructions = std::move(instructions);
+  return true;
+}
+
+static void merge_sinksources(ComputeGraph &compute_graph, uint32_t nid,
+                              const BindingGroups &groups, uint32_t pc_offset,
+                              const std::vector<uint32_t> &incoming,
+                              const std::vector<uint32_t> &outgoing,
+                              std::vector<bool> &dropped) {
+  Node &node = compute_graph.nodes[nid];
+  auto &dispatch = std::get<ComputeDispatch>(node.op);
+  uint32_t member = 0;
+  for (const auto &group : groups) {
+    for (uint32_t index : group) {
+      const SinkSource &sinksource = node.sinksources[index];
+      dispatch.pc.fields.push_back(PushConstantField{
+          .offset =
+              static_cast<uint16_t>(pc_offset + member++ * sizeof(uint32_t)),
+          .type = PushConstantType::U32,
+          .value = *sinksource.tensor_offset,
+          .addend = sinksource.buffer_ssbo_offset,
+      });
+    }
+    // The whole buffer is bound, the offsets are applied by the shader.
+    SinkSource &leader = node.sinksources[group.front()];
+    leader.tensor_offset = std::nullopt;
+    leader.buffer_ssbo_offset = 0;
+  }
+  dispatch.pc.size =
+      static_cast<uint16_t>(pc_offset + member * sizeof(uint32_t));
+
+  for (uint32_t c : incoming) {
+    Connector &connector = compute_graph.connectors[c];
+    if (is_merged(groups, connector.dst_node_sinksource)) {
+      dropped[c] = true;
+    }
+    connector.dst_node_sinksource =
+        merged_index(groups, connector.dst_node_sinksource);
+  }
+  for (uint32_t c : outgoing) {
+    Connector &connector = compute_graph.connectors[c];
+    connector.src_node_sinksource =
+        merged_index(groups, connector.src_node_sinksource);
+  }
+  if (node.dummy_source.has_value()) {
+    node.dummy_source = merged_index(groups, *node.dummy_source);
+  }
+
+  std::vector<SinkSource> sinksources;
+  sinksources.reserve(node.sinksources.size());
+  for (uint32_t i = 0; i < node.sinksources.size(); ++i) {
+    if (!is_merged(groups, i)) {
+      sinksources.push_back(std::move(node.sinksources[i]));
+    }
+  }
+  node.sinksources = std::move(sinksources);
+}
+
+} // namespace vkdt_denox
+
+vkdt_denox::BindingMerging
+vkdt_denox::merge_buffer_bindings(ComputeGraph &compute_graph,
+                                  ShaderRegistry &shader_registry) {
+  BindingMerging result;
+
+  const uint32_t n = compute_graph.nodes.size();
+  std::vector<std::vector<uint32_t>> incoming(n);
+  std::vector<std::vector<uint32_t>> outgoing(n);
+  for (uint32_t c = 0; c < compute_graph.connectors.size(); ++c) {
+    const auto &connector = compute_graph.connectors[c];
+    if (connector.dst_node < n) {
+      incoming[connector.dst_node].push_back(c);
+    }
+    if (connector.src_node < n) {
+      outgoing[connector.src_node].push_back(c);
+    }
+  }
+
+  // (binary id, binding groups) -> dispatch nodes
+  std::map<std::pair<uint32_t, BindingGroups>, std::vector<uint32_t>>
+      binaries;
+  for (uint32_t nid = 0; nid < n; ++nid) {
+    const auto &node = compute_graph.nodes[nid];
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    BindingGroups groups = binding_groups(compute_graph, nid, incoming[nid]);
+    if (groups.empty()) {
+      continue;
+    }
+    const auto &dispatch = std::get<ComputeDispatch>(node.op);
+    binaries[{dispatch.binary_id, std::move(groups)}].push_back(nid);
+  }
+
+  std::vector<bool> dropped(compute_graph.connectors.size(), false);
+  for (const auto &[key, nodes] : binaries) {
+    const auto &[binary_id, groups] = key;
+    uint16_t pc_size = 0;
+    for (uint32_t nid : nodes) {
+      const auto &dispatch =
+          std::get<ComputeDispatch>(compute_graph.nodes[nid].op);
+      pc_size = std::max(pc_size, dispatch.pc.size);
+    }
+    const auto pc_offset = static_cast<uint32_t>(align_up(pc_size, 4));
+    uint32_t members = 0;
+    for (const auto &group : groups) {
+      members += static_cast<uint32_t>(group.size());
+    }
+
+    const auto &binary = shader_registry.binaries[binary_id];
+    if (pc_offset + members * sizeof(uint32_t) > max_push_constant_size) {
+      fmt::println(stderr,
+                   "Warning: kernel {} keeps its bindings, the offsets of {} "
+                   "merged bindings exceed {} bytes of push constants.",
+                   binary.name, members, max_push_constant_size);
+      continue;
+    }
+    spirv::Module module = spirv::parse(binary.spv);
+    const auto variables = merged_variables(module, groups);
+    if (!variables.has_value() ||
+        !offsets_aligned(compute_graph, nodes, *variables) ||
+        !offset_accesses(module, groups, *variables, pc_offset)) {
+      fmt::println(stderr,
+                   "Warning: kernel {} cannot be rewritten to bind each "
+                   "buffer once.",
+                   binary.name);
+      continue;
+    }
+    const uint32_t id =
+        register_shader_binary(shader_registry, spirv::assemble(module));
+    result.rewritten_binaries += 1;
+
+    for (uint32_t nid : nodes) {
+      merge_sinksources(compute_graph, nid, groups, pc_offset, incoming[nid],
+                        outgoing[nid], dropped);
+      std::get<ComputeDispatch>(compute_graph.nodes[nid].op).binary_id = id;
+      result.merged_bindings += members - static_cast<uint32_t>(groups.size());
+    }
+  }
+
+  std::vector<Connector> connectors;
+  connectors.reserve(compute_graph.connectors.size());
+  for (uint32_t c = 0; c < compute_graph.connectors.size(); ++c) {
+    if (!dropped[c]) {
+      connectors.push_back(compute_graph.connectors[c]);
+    }
+  }
+  compute_graph.connectors = std::move(connectors);
+
+  prune_shader_registry(shader_registry, compute_graph);
+  return result;
+}
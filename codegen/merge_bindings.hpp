@@ -0,0 +1,21 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include "shader_registry.hpp"
+#include <cstdint>
+namespace vkdt_denox {
+
+struct BindingMerging {
+  uint32_t merged_bindings = 0;
+  uint32_t rewritten_binaries = 0;
+};
+
+/// Binds all tensors, which a dispatch reads from the same buffer (e.g. the
+/// weights of a layer or the slices of a concat), through a single connector.
+/// The buffer is bound from its start, the byte offsets of the tensors are
+/// appended to the push constants and the shaders are rewritten to add them
+/// to the indices of their storage buffer accesses.
+BindingMerging merge_buffer_bindings(ComputeGraph &compute_graph,
+                                     ShaderRegistry &shader_registry);
+
+} // namespace vkdt_denox
@@ -0,0 +1,112 @@
+#include "output_writer.hpp"
+#include "io.hpp"
+#include "util.hpp"
+#include <cstring>
+#include <fmt/format.h>
+#include <sstream>
+
+static int64_t modification_time(const std::filesystem::path &path) {
+  return std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+vkdt_denox::OutputWriter::OutputWriter(
+    std::optional<std::filesystem::path> manifest_path)
+    : m_manifest_path(std::move(manifest_path)) {
+  if (!m_manifest_path.has_value() ||
+      !std::filesystem::exists(*m_manifest_path)) {
+    return;
+  }
+  // One line per file: <hash> <size> <mtime> <path>
+  std::istringstream manifest(read_file(m_manifest_path->string()));
+  std::string line;
+  while (std::getline(manifest, line)) {
+    std::istringstream fields(line);
+    Entry entry;
+    std::string path;
+    fields >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.mtime;
+    fields.get();
+    if (!fields || !std::getline(fields, path)) {
+      continue; // ignore malformed lines, the file is compared instead.
+    }
+    m_entries[path] = entry;
+  }
+}
+
+bool vkdt_denox::OutputWriter::is_unchanged(
+    const std::string &path, uint64_t hash,
+    std::span<const std::span<const uint8_t>> chunks, std::size_t size) const {
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec) ||
+      std::filesystem::file_size(path, ec) != size) {
+    return false;
+  }
+  std::optional<Entry> entry;
+  {
+    std::lock_guard lock{m_mutex};
+    auto it = m_entries.find(path);
+    if (it != m_entries.end()) {
+      entry = it->second;
+    }
+  }
+  if (entry.has_value() && entry->size == size &&
+      entry->mtime == modification_time(path)) {
+    return entry->hash == hash;
+  }
+  // Mapped, such that large outputs are not copied into memory.
+  const MappedFile existing(path);
+  if (existing.size() != size) {
+    return false;
+  }
+  std::size_t offset = 0;
+  for (const auto &chunk : chunks) {
+    if (!chunk.empty() &&
+        std::memcmp(existing.data() + offset, chunk.data(), chunk.size()) !=
+            0) {
+      return false;
+    }
+    offset += chunk.size();
+  }
+  return true;
+}
+
+bool vkdt_denox::OutputWriter::write(
+    const std::filesystem::path &path,
+    std::span<const std::span<const uint8_t>> chunks) {
+  const std::string key = std::filesystem::weakly_canonical(path).string();
+  uint64_t hash = fnv1a64(nullptr, 0);
+  std::size_t size = 0;
+  for (const auto &chunk : chunks) {
+    hash = fnv1a64(chunk.data(), chunk.size(), hash);
+    size += chunk.size();
+  }
+  const bool changed = !is_unchanged(key, hash, chunks, size);
+  if (changed) {
+    write_file_chunks(key, chunks);
+  }
+  const Entry entry{
+      .hash = hash,
+      .size = size,
+      .mtime = modification_time(key),
+  };
+  std::lock_guard lock{m_mutex};
+  ++(changed ? m_written : m_unchanged);
+  m_entries[key] = entry;
+  return changed;
+}
+
+void vkdt_denox::OutputWriter::finish() {
+  if (!m_manifest_path.has_value()) {
+    return;
+  }
+  std::lock_guard lock{m_mutex};
+  std::string manifest;
+  for (const auto &[path, entry] : m_entries) {
+    manifest.append(fmt::format("{:016x} {} {} {}\n", entry.hash, entry.size,
+                                entry.mtime, path));
+  }
+  // The manifest itself is only rewritten if an entry changed.
+  if (!std::filesystem::exists(*m_manifest_path) ||
+      read_file(m_manifest_path->string()) != manifest) {
+    write_file(m_manifest_path->string(), manifest);
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+namespace vkdt_denox {
+
+/// Writes generated files only if their content changed, such that vkdt's
+/// build does not rebuild and reinstall unchanged outputs.
+///
+/// Without a manifest, existing files are compared byte by byte (unless
+/// their size differs). The optional manifest records the content hash, size
+/// and modification time of every written file, such that unchanged large
+/// outputs are recognized without rereading them.
+///
+/// Different files may be written concurrently.
+class OutputWriter {
+private:
+  struct Entry {
+    uint64_t hash;
+    uint64_t size;
+    int64_t mtime;
+  };
+
+public:
+  explicit OutputWriter(
+      std::optional<std::filesystem::path> manifest_path = std::nullopt);
+
+  /// Writes the concatenation of the chunks, which is never assembled in
+  /// memory. Returns true if the file was written, false if it was unchanged.
+  bool write(const std::filesystem::path &path,
+             std::span<const std::span<const uint8_t>> chunks);
+
+  bool write(const std::filesystem::path &path, const void *data,
+             std::size_t size) {
+    const std::span<const uint8_t> chunk(static_cast<const uint8_t *>(data),
+                                         size);
+    return write(path, std::span(&chunk, 1));
+  }
+
+  bool write(const std::filesystem::path &path, const std::string &data) {
+    return write(path, data.data(), data.size());
+  }
+
+  /// Writes the manifest, if any.
+  void finish();
+
+  std::size_t written() const { return m_written; }
+  std::size_t unchanged() const { return m_unchanged; }
+
+private:
+  bool is_unchanged(const std::string &path, uint64_t hash,
+                    std::span<const std::span<const uint8_t>> chunks,
+                    std::size_t size) const;
+
+  std::optional<std::filesystem::path> m_manifest_path;
+  // Guards m_entries and the counters.
+  mutable std::mutex m_mutex;
+  std::map<std::string, Entry> m_entries;
+  std::size_t m_written = 0;
+  std::size_t m_unchanged = 0;
+};
+
+} // namespace vkdt_denox
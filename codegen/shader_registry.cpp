@@ -1,20 +1,209 @@
 #include "shader_registry.hpp"
+#include "compute_graph.hpp"
+#include "spirv.hpp"
+#include "util.hpp"
+#include <algorithm>
 #include <fmt/format.h>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <variant>
+
+// vkdt refers to kernels by dt_token_t, which holds at most 8 characters.
+static constexpr std::size_t SHADER_NAME_LENGTH = 8;
+
+/// Derives a kernel name from the content hash of a binary, such that
+/// unchanged kernels keep their name across model updates.
+static std::string shader_name(uint64_t hash) {
+  static constexpr std::string_view alphabet =
+      "abcdefghijklmnopqrstuvwxyz234567";
+  // leading letter, such that the name is also a valid identifier.
+  std::string name = "d";
+  while (name.size() < SHADER_NAME_LENGTH) {
+    name.push_back(alphabet[hash & 31]);
+    hash >>= 5;
+  }
+  return name;
+}
+
+static std::optional<uint32_t>
+find_shader_binary(const vkdt_denox::ShaderRegistry &registry, uint64_t hash,
+                   std::span<const uint32_t> spv) {
+  auto candidates = registry.hash_index.find(hash);
+  if (candidates == registry.hash_index.end()) {
+    return std::nullopt;
+  }
+  for (uint32_t id : candidates->second) {
+    if (std::ranges::equal(registry.binaries[id].spv, spv)) {
+      return id;
+    }
+  }
+  return std::nullopt;
+}
+
+static uint32_t add_shader_binary(vkdt_denox::ShaderRegistry &registry,
+                                  uint64_t hash,
+                                  std::span<const uint32_t> spv) {
+  // Short names may collide for different binaries, in which case we
+  // rehash until we find a free name.
+  std::string name = shader_name(hash);
+  for (uint64_t h = hash; registry.names.contains(name);) {
+    h = vkdt_denox::fnv1a64(&h, sizeof(h), h);
+    name = shader_name(h);
+  }
+  registry.names.insert(name);
+
+  const uint32_t id = registry.binaries.size();
+  registry.hash_index[hash].push_back(id);
+  registry.binaries.push_back(vkdt_denox::ShaderBinary{
+      .name = std::move(name),
+      .spv = spv,
+      .hash = hash,
+      .local_size =
+          vkdt_denox::spirv::reflect_local_size(vkdt_denox::spirv::parse(spv)),
+  });
+  return id;
+}
+
+uint32_t vkdt_denox::register_shader_binary(ShaderRegistry &registry,
+                                            std::span<const uint32_t> spv) {
+  const uint64_t hash = fnv1a64(spv.data(), spv.size_bytes());
+  if (auto id = find_shader_binary(registry, hash, spv)) {
+    return *id;
+  }
+  return add_shader_binary(registry, hash, spv);
+}
+
+uint32_t vkdt_denox::register_shader_binary(ShaderRegistry &registry,
+                                            std::vector<uint32_t> &&spv) {
+  const uint64_t hash = fnv1a64(spv.data(), spv.size() * sizeof(uint32_t));
+  if (auto id = find_shader_binary(registry, hash, spv)) {
+    return *id;
+  }
+  const auto &stored = registry.storage.emplace_back(std::move(spv));
+  return add_shader_binary(registry, hash, stored);
+}
 
 vkdt_denox::ShaderRegistry
 vkdt_denox::create_shader_registry(const denox::dnx::Model *dnx) {
-
-  const uint32_t binary_count = dnx->shader_binaries()->size();
+  const uint32_t dispatch_count = dnx->dispatches()->size();
 
   ShaderRegistry registry;
-  registry.binaries.resize(binary_count);
+  registry.dispatch_binary_ids.resize(dispatch_count);
 
-  for (uint32_t i = 0; i < binary_count; ++i) {
-    const auto *binary = dnx->shader_binaries()->Get(i);
-    registry.binaries[i].name = fmt::format("comp{}", i);
-    registry.binaries[i].spv = std::span<const uint32_t>{
-        binary->spirv()->data(), binary->spirv()->size()};
+  // (dnx binary id, entry point) -> index into registry.binaries
+  std::map<std::pair<uint32_t, std::string>, uint32_t> registered;
+
+  for (uint32_t d = 0; d < dispatch_count; ++d) {
+    const auto *dispatch = dnx->dispatches()->Get(d);
+    const uint32_t binary_id = dispatch->binary_id();
+    std::string entry_point = "main";
+    if (dispatch->entry_point() != nullptr &&
+        dispatch->entry_point()->size() != 0) {
+      entry_point = dispatch->entry_point()->str();
+    }
+
+    auto key = std::make_pair(binary_id, entry_point);
+    auto it = registered.find(key);
+    if (it != registered.end()) {
+      registry.dispatch_binary_ids[d] = it->second;
+      continue;
+    }
+
+    if (binary_id >= dnx->shader_binaries()->size()) {
+      throw std::runtime_error(fmt::format(
+          "invalid dnx: dispatch {} references binary {}, which does not "
+          "exist.",
+          d, binary_id));
+    }
+    const auto *binary = dnx->shader_binaries()->Get(binary_id);
+    const std::span<const uint32_t> spv{binary->spirv()->data(),
+                                        binary->spirv()->size()};
+
+    // vkdt always creates pipelines with the entry point "main". Binaries
+    // with several entry points (or a differently named one) are split into
+    // one module per entry point, which is renamed to "main".
+    const spirv::Module module = spirv::parse(spv);
+    const auto entries = spirv::entry_points(module);
+    uint32_t id;
+    if (entries.size() == 1 && entries.front().name == "main" &&
+        entry_point == "main") {
+      id = register_shader_binary(registry, spv);
+    } else {
+      id = register_shader_binary(
+          registry,
+          spirv::assemble(spirv::extract_entry_point(module, entry_point)));
+    }
+    registered.emplace(std::move(key), id);
+    registry.dispatch_binary_ids[d] = id;
   }
 
   return registry;
 }
+
+void vkdt_denox::prune_shader_registry(ShaderRegistry &registry,
+                                       ComputeGraph &compute_graph) {
+  std::vector<uint32_t> remap(registry.binaries.size(), none_sentinal);
+  for (const auto &node : compute_graph.nodes) {
+    if (std::holds_alternative<ComputeDispatch>(node.op)) {
+      remap[std::get<ComputeDispatch>(node.op).binary_id] = 0;
+    }
+  }
+
+  std::vector<ShaderBinary> binaries;
+  registry.hash_index.clear();
+  registry.names.clear();
+  for (uint32_t i = 0; i < registry.binaries.size(); ++i) {
+    if (remap[i] == none_sentinal) {
+      continue;
+    }
+    remap[i] = binaries.size();
+    registry.hash_index[registry.binaries[i].hash].push_back(remap[i]);
+    registry.names.insert(registry.binaries[i].name);
+    binaries.push_back(std::move(registry.binaries[i]));
+  }
+  registry.binaries = std::move(binaries);
+
+  for (auto &node : compute_graph.nodes) {
+    if (std::holds_alternative<ComputeDispatch>(node.op)) {
+      auto &dispatch = std::get<ComputeDispatch>(node.op);
+      dispatch.binary_id = remap[dispatch.binary_id];
+    }
+  }
+  for (auto &id : registry.dispatch_binary_ids) {
+    id = remap[id];
+  }
+}
+
+void vkdt_denox::merge_into_shader_registry(
+    ShaderRegistry &store, const ShaderRegistry &registry,
+    std::span<ComputeGraph> compute_graphs) {
+  std::vector<uint32_t> remap;
+  remap.reserve(registry.binaries.size());
+  for (const auto &binary : registry.binaries) {
+    // The store owns a copy, such that it does not depend on the lifetime of
+    // the merged registry.
+    remap.push_back(register_shader_binary(
+        store, std::vector<uint32_t>(binary.spv.begin(), binary.spv.end())));
+  }
+  for (auto &compute_graph : compute_graphs) {
+    for (auto &node : compute_graph.nodes) {
+      if (std::holds_alternative<ComputeDispatch>(node.op)) {
+        auto &dispatch = std::get<ComputeDispatch>(node.op);
+        dispatch.binary_id = remap[dispatch.binary_id];
+      }
+    }
+  }
+}
+
+vkdt_denox::ShaderRegistry vkdt_denox::merge_shader_registries(
+    std::span<const ShaderRegistry> registries,
+    std::span<ComputeGraph> compute_graphs) {
+  assert(registries.size() == compute_graphs.size());
+  ShaderRegistry merged;
+  for (std::size_t r = 0; r < registries.size(); ++r) {
+    merge_into_shader_registry(merged, registries[r],
+                               compute_graphs.subspan(r, 1));
+  }
+  return merged;
+}
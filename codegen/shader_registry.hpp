@@ -1,21 +1,73 @@
 #pragma once
 
+#include "spirv.hpp"
 #include <cstdint>
+#include <deque>
 #include <dnx.h>
 #include <span>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 namespace vkdt_denox {
 
+struct ComputeGraph;
+
 struct ShaderBinary {
   std::string name;
   std::span<const uint32_t> spv;
+  uint64_t hash;
+  // Workgroup size declared by the binary, if it could be reflected.
+  std::optional<spirv::LocalSize> local_size;
 };
 
 struct ShaderRegistry {
+  // Unique binaries, byte-identical shader binaries are stored once.
   std::vector<ShaderBinary> binaries;
+  // Maps dnx dispatch ids to indices into binaries. Consumed by
+  // reconstruct_compute_graph, afterwards ComputeDispatch::binary_id is
+  // authoritative.
+  std::vector<uint32_t> dispatch_binary_ids;
+
+  // Maps content hashes to candidate indices into binaries.
+  std::unordered_map<uint64_t, std::vector<uint32_t>> hash_index;
+  std::unordered_set<std::string> names;
+  // Binaries rewritten by the codegen. Elements of a deque are never
+  // relocated, such that the spans of binaries stay valid.
+  std::deque<std::vector<uint32_t>> storage;
+  // vkdt module, which holds the binaries, if they are shared by several
+  // modules. Empty for binaries of the generated module itself.
+  std::string module;
 };
 
 ShaderRegistry create_shader_registry(const denox::dnx::Model *dnx);
 
+/// Adds a binary to the registry, returns the index of an identical binary if
+/// one is already registered. The span must outlive the registry.
+uint32_t register_shader_binary(ShaderRegistry &registry,
+                                std::span<const uint32_t> spv);
+
+/// Same as above, but the registry takes ownership of the words.
+uint32_t register_shader_binary(ShaderRegistry &registry,
+                                std::vector<uint32_t> &&spv);
+
+/// Removes binaries, which are not referenced by any dispatch of the compute
+/// graph, and remaps the binary ids of the dispatches.
+void prune_shader_registry(ShaderRegistry &registry,
+                           ComputeGraph &compute_graph);
+
+/// Adds the binaries of a registry to the store, which already stores
+/// identical binaries once, and remaps the binary ids of the dispatches of the
+/// compute graphs, which refer to the registry.
+void merge_into_shader_registry(ShaderRegistry &store,
+                                const ShaderRegistry &registry,
+                                std::span<ComputeGraph> compute_graphs);
+
+/// Merges the registries of several compute graphs into one registry, which
+/// stores identical binaries once, and remaps the binary ids of the dispatches
+/// of compute_graphs[i], which refer to registries[i].
+ShaderRegistry
+merge_shader_registries(std::span<const ShaderRegistry> registries,
+                        std::span<ComputeGraph> compute_graphs);
+
 } // namespace vkdt_denox
@@ -0,0 +1,904 @@
+#include "spirv.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace vkdt_denox::spirv {
+
+Module parse(std::span<const uint32_t> spv) {
+  if (spv.size() < HEADER_WORDS || spv[0] != MAGIC) {
+    throw std::runtime_error("invalid SPIR-V binary: missing header.");
+  }
+  Module module;
+  std::copy_n(spv.begin(), HEADER_WORDS, module.header.begin());
+  std::size_t i = HEADER_WORDS;
+  while (i < spv.size()) {
+    const uint32_t word_count = spv[i] >> 16;
+    if (word_count == 0 || i + word_count > spv.size()) {
+      throw std::runtime_error(fmt::format(
+          "invalid SPIR-V binary: malformed instruction at word {}.", i));
+    }
+    module.instructions.push_back(Instruction{
+        .words = std::vector<uint32_t>(spv.begin() + i,
+                                       spv.begin() + i + word_count),
+    });
+    i += word_count;
+  }
+  return module;
+}
+
+std::vector<uint32_t> assemble(const Module &module) {
+  std::size_t size = HEADER_WORDS;
+  for (const auto &inst : module.instructions) {
+    size += inst.words.size();
+  }
+  std::vector<uint32_t> spv;
+  spv.reserve(size);
+  spv.insert(spv.end(), module.header.begin(), module.header.end());
+  for (const auto &inst : module.instructions) {
+    assert(inst.words.size() == (inst.words[0] >> 16));
+    spv.insert(spv.end(), inst.words.begin(), inst.words.end());
+  }
+  return spv;
+}
+
+Instruction make_instruction(Op opcode,
+                             std::initializer_list<uint32_t> operands) {
+  Instruction inst;
+  inst.words.reserve(operands.size() + 1);
+  inst.words.push_back(
+      (static_cast<uint32_t>(operands.size() + 1) << 16) | opcode);
+  inst.words.insert(inst.words.end(), operands.begin(), operands.end());
+  return inst;
+}
+
+std::string read_string(std::span<const uint32_t> words) {
+  std::string str;
+  for (uint32_t word : words) {
+    for (uint32_t b = 0; b < 4; ++b) {
+      const char c = static_cast<char>((word >> (8 * b)) & 0xFF);
+      if (c == '\0') {
+        return str;
+      }
+      str.push_back(c);
+    }
+  }
+  throw std::runtime_error("invalid SPIR-V binary: unterminated string.");
+}
+
+std::size_t string_word_count(std::span<const uint32_t> words) {
+  return read_string(words).size() / 4 + 1;
+}
+
+void append_string(std::vector<uint32_t> &words, std::string_view str) {
+  const std::size_t count = str.size() / 4 + 1;
+  const std::size_t begin = words.size();
+  words.resize(begin + count, 0);
+  std::memcpy(words.data() + begin, str.data(), str.size());
+}
+
+ResultLayout result_layout(Op opcode) {
+  switch (static_cast<uint32_t>(opcode)) {
+  // Instructions without a result.
+  case OpNop:
+  case OpSourceContinued:
+  case OpSource:
+  case OpSourceExtension:
+  case OpName:
+  case OpMemberName:
+  case OpLine:
+  case OpExtension:
+  case OpMemoryModel:
+  case OpEntryPoint:
+  case OpExecutionMode:
+  case OpCapability:
+  case OpTypeForwardPointer:
+  case OpFunctionEnd:
+  case OpStore:
+  case 63:  // OpCopyMemory
+  case 64:  // OpCopyMemorySized
+  case OpDecorate:
+  case OpMemberDecorate:
+  case 74:  // OpGroupDecorate
+  case 75:  // OpGroupMemberDecorate
+  case 99:  // OpImageWrite
+  case 218: // OpEmitVertex
+  case 219: // OpEndPrimitive
+  case 220: // OpEmitStreamVertex
+  case 221: // OpEndStreamPrimitive
+  case 224: // OpControlBarrier
+  case 225: // OpMemoryBarrier
+  case 228: // OpAtomicStore
+  case OpLoopMerge:
+  case OpSelectionMerge:
+  case OpBranch:
+  case OpBranchConditional:
+  case 251: // OpSwitch
+  case 252: // OpKill
+  case OpReturn:
+  case 254: // OpReturnValue
+  case 255: // OpUnreachable
+  case 256: // OpLifetimeStart
+  case 257: // OpLifetimeStop
+  case 319: // OpAtomicFlagClear
+  case OpNoLine:
+  case OpModuleProcessed:
+  case OpExecutionModeId:
+  case OpDecorateId:
+  case 4416: // OpTerminateInvocation
+  case 4458: // OpCooperativeMatrixStoreKHR
+  case 5360: // OpCooperativeMatrixStoreNV
+  case 5380: // OpDemoteToHelperInvocation
+  case 5630: // OpAssumeTrueKHR
+  case OpDecorateString:
+  case OpMemberDecorateString:
+    return ResultLayout{};
+  // Instructions with a result, but without a result type.
+  case OpString:
+  case OpExtInstImport:
+  case OpTypeVoid:
+  case OpTypeBool:
+  case OpTypeInt:
+  case OpTypeFloat:
+  case OpTypeVector:
+  case 24: // OpTypeMatrix
+  case 25: // OpTypeImage
+  case 26: // OpTypeSampler
+  case 27: // OpTypeSampledImage
+  case OpTypeArray:
+  case OpTypeRuntimeArray:
+  case OpTypeStruct:
+  case 31: // OpTypeOpaque
+  case OpTypePointer:
+  case OpTypeFunction:
+  case 34: // OpTypeEvent
+  case 35: // OpTypeDeviceEvent
+  case 36: // OpTypeReserveId
+  case 37: // OpTypeQueue
+  case 38: // OpTypePipe
+  case OpDecorationGroup:
+  case OpLabel:
+  case 322:  // OpTypePipeStorage
+  case 327:  // OpTypeNamedBarrier
+  case 4456: // OpTypeCooperativeMatrixKHR
+  case 4472: // OpTypeRayQueryKHR
+  case 5341: // OpTypeAccelerationStructureKHR
+  case 5358: // OpTypeCooperativeMatrixNV
+    return ResultLayout{.type = std::nullopt, .result = 1};
+  default:
+    return ResultLayout{.type = 1, .result = 2};
+  }
+}
+
+std::optional<uint32_t> result_id(const Instruction &instruction) {
+  const ResultLayout layout = result_layout(instruction.opcode());
+  if (!layout.result.has_value() ||
+      *layout.result >= instruction.words.size()) {
+    return std::nullopt;
+  }
+  return instruction.words[*layout.result];
+}
+
+/// Appends the positions of the ids among the memory operands, which start at
+/// words[pos], and advances pos past them.
+static bool append_memory_operand_ids(const Instruction &instruction,
+                                      std::size_t &pos,
+                                      std::vector<uint32_t> &ids) {
+  if (pos >= instruction.words.size()) {
+    return true;
+  }
+  const uint32_t mask = instruction.words[pos++];
+  // Volatile, Aligned, Nontemporal, MakePointerAvailable, MakePointerVisible
+  // and NonPrivatePointer.
+  if ((mask & ~0x3Fu) != 0) {
+    return false;
+  }
+  if ((mask & 0x2) != 0) { // Aligned takes a literal.
+    ++pos;
+  }
+  if ((mask & 0x8) != 0) { // MakePointerAvailable takes a scope.
+    ids.push_back(static_cast<uint32_t>(pos++));
+  }
+  if ((mask & 0x10) != 0) { // MakePointerVisible takes a scope.
+    ids.push_back(static_cast<uint32_t>(pos++));
+  }
+  return pos <= instruction.words.size();
+}
+
+/// Position of the image operands mask of image instructions. All other
+/// operands of these instructions are ids.
+static std::optional<uint32_t> image_operands_position(uint32_t opcode) {
+  switch (opcode) {
+  case 99: // OpImageWrite
+    return 4;
+  case 87: // OpImageSampleImplicitLod
+  case 88: // OpImageSampleExplicitLod
+  case 91: // OpImageSampleProjImplicitLod
+  case 92: // OpImageSampleProjExplicitLod
+  case 95: // OpImageFetch
+  case 98: // OpImageRead
+    return 5;
+  case 89: // OpImageSampleDrefImplicitLod
+  case 90: // OpImageSampleDrefExplicitLod
+  case 93: // OpImageSampleProjDrefImplicitLod
+  case 94: // OpImageSampleProjDrefExplicitLod
+  case 96: // OpImageGather
+  case 97: // OpImageDrefGather
+    return 6;
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<std::vector<uint32_t>> id_positions(const Module &module,
+                                                  const Instruction &inst) {
+  const auto &words = inst.words;
+  const uint32_t n = static_cast<uint32_t>(words.size());
+  std::vector<uint32_t> ids;
+  auto append_range = [&](uint32_t first, uint32_t last) {
+    for (uint32_t w = first; w < std::min(last, n); ++w) {
+      ids.push_back(w);
+    }
+  };
+
+  const uint32_t opcode = inst.opcode();
+  if (auto mask = image_operands_position(opcode)) {
+    append_range(1, *mask);
+    append_range(*mask + 1, n);
+    return ids;
+  }
+  switch (opcode) {
+  // Instructions without ids.
+  case OpNop:
+  case OpSourceContinued:
+  case OpSourceExtension:
+  case OpExtension:
+  case OpMemoryModel:
+  case OpCapability:
+  case OpFunctionEnd:
+  case 252: // OpKill
+  case OpReturn:
+  case 255: // OpUnreachable
+  case OpNoLine:
+  case OpModuleProcessed:
+  case 4416: // OpTerminateInvocation
+  case 5380: // OpDemoteToHelperInvocation
+    return ids;
+  // Instructions, whose only id is the first operand.
+  case OpName:
+  case OpMemberName:
+  case OpString:
+  case OpLine:
+  case OpExtInstImport:
+  case OpExecutionMode:
+  case OpTypeVoid:
+  case OpTypeBool:
+  case OpTypeInt:
+  case OpTypeFloat:
+  case 26: // OpTypeSampler
+  case OpTypeForwardPointer:
+  case OpDecorate:
+  case OpMemberDecorate:
+  case OpDecorationGroup:
+  case OpSelectionMerge:
+  case OpLabel:
+  case OpBranch:
+  case 254: // OpReturnValue
+  case 256: // OpLifetimeStart
+  case 257: // OpLifetimeStop
+  case 4472: // OpTypeRayQueryKHR
+  case 5341: // OpTypeAccelerationStructureKHR
+  case OpDecorateString:
+  case OpMemberDecorateString:
+    append_range(1, 2);
+    return ids;
+  // Instructions, whose first two operands are ids, followed by literals.
+  case OpTypeVector:
+  case 24: // OpTypeMatrix
+  case 25: // OpTypeImage
+  case 27: // OpTypeSampledImage
+  case OpTypeRuntimeArray:
+  case OpConstant:
+  case 45: // OpConstantSampler
+  case OpSpecConstant:
+  case OpLoopMerge:
+    append_range(1, 3);
+    return ids;
+  // Instructions, whose operands are all ids.
+  case 1: // OpUndef
+  case OpTypeArray:
+  case OpTypeStruct:
+  case OpTypeFunction:
+  case OpConstantTrue:
+  case OpConstantFalse:
+  case OpConstantComposite:
+  case OpConstantNull:
+  case OpSpecConstantTrue:
+  case OpSpecConstantFalse:
+  case OpSpecConstantComposite:
+  case OpFunctionParameter:
+  case OpFunctionCall:
+  case 60: // OpImageTexelPointer
+  case OpAccessChain:
+  case OpInBoundsAccessChain:
+  case OpPtrAccessChain:
+  case 69: // OpGenericPtrMemSemantics
+  case 70: // OpInBoundsPtrAccessChain
+  case 74: // OpGroupDecorate
+  case 77: // OpVectorExtractDynamic
+  case 78: // OpVectorInsertDynamic
+  case OpCompositeConstruct:
+  case OpCopyObject:
+  case 84:  // OpTranspose
+  case 86:  // OpSampledImage
+  case 224: // OpControlBarrier
+  case 225: // OpMemoryBarrier
+  case 227: // OpAtomicLoad
+  case 228: // OpAtomicStore
+  case OpPhi:
+  case OpBranchConditional:
+  case 321: // OpSizeOf
+  case 400: // OpCopyLogical
+  case 401: // OpPtrEqual
+  case 402: // OpPtrNotEqual
+  case 403: // OpPtrDiff
+  case 4421: // OpSubgroupBallotKHR
+  case 4422: // OpSubgroupFirstInvocationKHR
+  case 4431: // OpGroupNonUniformRotateKHR
+  case 4456: // OpTypeCooperativeMatrixKHR
+  case 4460: // OpCooperativeMatrixLengthKHR
+  case 5056: // OpReadClockKHR
+  case 5358: // OpTypeCooperativeMatrixNV
+  case 5361: // OpCooperativeMatrixMulAddNV
+  case 5362: // OpCooperativeMatrixLengthNV
+  case 5614: // OpAtomicFMinEXT
+  case 5615: // OpAtomicFMaxEXT
+  case 5630: // OpAssumeTrueKHR
+  case 5631: // OpExpectKHR
+  case 6035: // OpAtomicFAddEXT
+    append_range(1, n);
+    return ids;
+  case OpExtInst:
+    // The operands of GLSL.std.450 and NonSemantic.* instructions are ids.
+    append_range(1, 4);
+    append_range(5, n);
+    return ids;
+  case OpEntryPoint:
+    ids.push_back(2);
+    append_range(3 + static_cast<uint32_t>(string_word_count(
+                         std::span(words).subspan(std::min(3u, n)))),
+                 n);
+    return ids;
+  case OpTypePointer:
+    ids.insert(ids.end(), {1, 3});
+    return ids;
+  case OpFunction:
+    ids.insert(ids.end(), {1, 2, 4});
+    return ids;
+  case OpVariable:
+    append_range(1, 3);
+    append_range(4, 5);
+    return ids;
+  case OpSpecConstantOp:
+    append_range(1, 3);
+    switch (n > 3 ? words[3] : 0) {
+    case OpCompositeExtract:
+      append_range(4, 5);
+      break;
+    case 79: // OpVectorShuffle
+    case OpCompositeInsert:
+      append_range(4, 6);
+      break;
+    default:
+      append_range(4, n);
+      break;
+    }
+    return ids;
+  case OpLoad: {
+    append_range(1, 4);
+    std::size_t pos = 4;
+    if (!append_memory_operand_ids(inst, pos, ids)) {
+      return std::nullopt;
+    }
+    return ids;
+  }
+  case OpStore:
+  case 63: // OpCopyMemory
+  case 64: // OpCopyMemorySized
+  {
+    // OpCopyMemory* take separate memory operands for target and source.
+    std::size_t pos = opcode == 64 ? 4 : 3;
+    append_range(1, static_cast<uint32_t>(pos));
+    if (!append_memory_operand_ids(inst, pos, ids) ||
+        (opcode != OpStore && !append_memory_operand_ids(inst, pos, ids))) {
+      return std::nullopt;
+    }
+    return ids;
+  }
+  case 68: // OpArrayLength
+  case OpCompositeExtract:
+    append_range(1, 4);
+    return ids;
+  case 79: // OpVectorShuffle
+  case OpCompositeInsert:
+    append_range(1, 5);
+    return ids;
+  case 75: // OpGroupMemberDecorate
+    append_range(1, 2);
+    for (uint32_t w = 2; w < n; w += 2) {
+      ids.push_back(w);
+    }
+    return ids;
+  case OpExecutionModeId:
+  case OpDecorateId:
+    append_range(1, 2);
+    append_range(3, n);
+    return ids;
+  case 251: { // OpSwitch
+    append_range(1, 3);
+    // The width of the case literals is the one of the selector.
+    const Instruction *selector =
+        n > 1 ? find_definition(module, words[1]) : nullptr;
+    const Instruction *type =
+        selector != nullptr && selector->words.size() > 1
+            ? find_definition(module, selector->words[1])
+            : nullptr;
+    if (type == nullptr || type->opcode() != OpTypeInt) {
+      return std::nullopt;
+    }
+    const uint32_t literal_words = type->words[2] == 64 ? 2 : 1;
+    for (uint32_t w = 3 + literal_words; w < n; w += literal_words + 1) {
+      ids.push_back(w);
+    }
+    return ids;
+  }
+  case 342: // OpGroupNonUniformBallotBitCount
+    // The group operation is a literal.
+    append_range(1, 4);
+    append_range(5, n);
+    return ids;
+  case 4457: { // OpCooperativeMatrixLoadKHR
+    append_range(1, 6);
+    std::size_t pos = 6;
+    if (!append_memory_operand_ids(inst, pos, ids)) {
+      return std::nullopt;
+    }
+    return ids;
+  }
+  case 4458: { // OpCooperativeMatrixStoreKHR
+    append_range(1, 5);
+    std::size_t pos = 5;
+    if (!append_memory_operand_ids(inst, pos, ids)) {
+      return std::nullopt;
+    }
+    return ids;
+  }
+  case 4459: // OpCooperativeMatrixMulAddKHR
+    append_range(1, 6);
+    return ids;
+  case 5359: { // OpCooperativeMatrixLoadNV
+    append_range(1, 6);
+    std::size_t pos = 6;
+    if (!append_memory_operand_ids(inst, pos, ids)) {
+      return std::nullopt;
+    }
+    return ids;
+  }
+  case 5360: { // OpCooperativeMatrixStoreNV
+    append_range(1, 5);
+    std::size_t pos = 5;
+    if (!append_memory_operand_ids(inst, pos, ids)) {
+      return std::nullopt;
+    }
+    return ids;
+  }
+  default:
+    break;
+  }
+  // Conversion, arithmetic, bit, relational, derivative and atomic
+  // instructions as well as most non-uniform group instructions only take
+  // ids.
+  if ((opcode >= 100 && opcode <= 107) || (opcode >= 109 && opcode <= 122) ||
+      (opcode >= 124 && opcode <= 152) ||
+      (opcode >= 154 && opcode <= 191) || (opcode >= 194 && opcode <= 205) ||
+      (opcode >= 207 && opcode <= 215) || (opcode >= 229 && opcode <= 242) ||
+      (opcode >= 333 && opcode <= 348) || opcode == 365 || opcode == 366) {
+    append_range(1, n);
+    return ids;
+  }
+  // Arithmetic non-uniform group instructions take a literal group operation.
+  if (opcode >= 349 && opcode <= 364) {
+    append_range(1, 4);
+    append_range(5, n);
+    return ids;
+  }
+  return std::nullopt;
+}
+
+std::vector<EntryPoint> entry_points(const Module &module) {
+  std::vector<EntryPoint> entries;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() != OpEntryPoint) {
+      continue;
+    }
+    entries.push_back(EntryPoint{
+        .execution_model = inst.words[1],
+        .function = inst.words[2],
+        .name = read_string(std::span(inst.words).subspan(3)),
+    });
+  }
+  return entries;
+}
+
+Module extract_entry_point(const Module &module, std::string_view name) {
+  const auto entries = entry_points(module);
+  auto it = std::ranges::find_if(entries, [&](const EntryPoint &entry) {
+    return entry.execution_model == ExecutionModelGLCompute &&
+           entry.name == name;
+  });
+  if (it == entries.end()) {
+    throw std::runtime_error(fmt::format(
+        "SPIR-V binary does not contain a compute entry point \"{}\".", name));
+  }
+  const uint32_t function = it->function;
+
+  Module extracted;
+  extracted.header = module.header;
+  extracted.instructions.reserve(module.instructions.size());
+  for (const auto &inst : module.instructions) {
+    switch (inst.opcode()) {
+    case OpEntryPoint: {
+      if (inst.words[2] != function) {
+        continue;
+      }
+      // Rename to "main", the interface ids follow the name.
+      const std::span<const uint32_t> operands(inst.words);
+      const std::size_t interface_begin =
+          3 + string_word_count(operands.subspan(3));
+      Instruction entry;
+      entry.words = {0, inst.words[1], inst.words[2]};
+      append_string(entry.words, "main");
+      entry.words.insert(entry.words.end(),
+                         inst.words.begin() + interface_begin,
+                         inst.words.end());
+      entry.words[0] =
+          (static_cast<uint32_t>(entry.words.size()) << 16) | OpEntryPoint;
+      extracted.instructions.push_back(std::move(entry));
+      break;
+    }
+    case OpExecutionMode:
+    case OpExecutionModeId:
+      if (inst.words[1] != function) {
+        continue;
+      }
+      extracted.instructions.push_back(inst);
+      break;
+    default:
+      extracted.instructions.push_back(inst);
+      break;
+    }
+  }
+  return extracted;
+}
+
+std::size_t function_section_begin(const Module &module) {
+  auto it = std::ranges::find_if(module.instructions, [](const auto &inst) {
+    return inst.opcode() == OpFunction;
+  });
+  return static_cast<std::size_t>(it - module.instructions.begin());
+}
+
+const Instruction *find_definition(const Module &module, uint32_t id) {
+  for (const auto &inst : module.instructions) {
+    if (result_id(inst) == id) {
+      return &inst;
+    }
+  }
+  return nullptr;
+}
+
+Definitions definitions(const Module &module) {
+  Definitions definitions;
+  definitions.reserve(module.instructions.size());
+  for (const auto &inst : module.instructions) {
+    if (auto id = result_id(inst); id.has_value()) {
+      definitions.emplace(*id, &inst);
+    }
+  }
+  return definitions;
+}
+
+const Instruction *find_definition(const Definitions &definitions,
+                                   uint32_t id) {
+  auto it = definitions.find(id);
+  return it == definitions.end() ? nullptr : it->second;
+}
+
+static std::optional<uint64_t> integer_value(const Instruction *constant,
+                                             const Instruction *type) {
+  if (type == nullptr || type->opcode() != OpTypeInt) {
+    return std::nullopt;
+  }
+  uint64_t value = constant->words[3];
+  if (type->words[2] == 64) {
+    value |= static_cast<uint64_t>(constant->words[4]) << 32;
+  } else if (type->words[2] < 32) {
+    value &= (uint64_t(1) << type->words[2]) - 1;
+  }
+  return value;
+}
+
+std::optional<uint64_t> constant_value(const Module &module, uint32_t id) {
+  const Instruction *inst = find_definition(module, id);
+  if (inst == nullptr || inst->opcode() != OpConstant) {
+    return std::nullopt;
+  }
+  return integer_value(inst, find_definition(module, inst->words[1]));
+}
+
+std::optional<uint64_t> constant_value(const Definitions &definitions,
+                                       uint32_t id) {
+  const Instruction *inst = find_definition(definitions, id);
+  if (inst == nullptr || inst->opcode() != OpConstant) {
+    return std::nullopt;
+  }
+  return integer_value(inst, find_definition(definitions, inst->words[1]));
+}
+
+uint32_t find_or_add_type(Module &module, Op opcode,
+                          std::initializer_list<uint32_t> operands) {
+  const std::size_t end = function_section_begin(module);
+  for (std::size_t i = 0; i < end; ++i) {
+    const auto &inst = module.instructions[i];
+    if (inst.opcode() != opcode || inst.words.size() != operands.size() + 2) {
+      continue;
+    }
+    if (std::equal(operands.begin(), operands.end(), inst.words.begin() + 2)) {
+      return inst.words[1];
+    }
+  }
+  const uint32_t id = module.allocate_id();
+  Instruction type;
+  type.words.reserve(operands.size() + 2);
+  type.words.push_back((static_cast<uint32_t>(operands.size() + 2) << 16) |
+                       opcode);
+  type.words.push_back(id);
+  type.words.insert(type.words.end(), operands.begin(), operands.end());
+  module.instructions.insert(module.instructions.begin() +
+                                 static_cast<std::ptrdiff_t>(end),
+                             std::move(type));
+  return id;
+}
+
+uint32_t find_or_add_constant(Module &module, uint32_t type, uint64_t value) {
+  const Instruction *type_inst = find_definition(module, type);
+  if (type_inst == nullptr || type_inst->opcode() != OpTypeInt) {
+    throw std::runtime_error("find_or_add_constant: expected integer type.");
+  }
+  const uint32_t width = type_inst->words[2];
+  const bool is_signed = type_inst->words[3] != 0;
+
+  std::vector<uint32_t> literal;
+  if (width == 64) {
+    literal = {static_cast<uint32_t>(value),
+               static_cast<uint32_t>(value >> 32)};
+  } else {
+    uint32_t word = static_cast<uint32_t>(value);
+    if (width < 32) {
+      // narrow literals are sign extended for signed types.
+      const uint32_t mask = (uint32_t(1) << width) - 1;
+      word &= mask;
+      if (is_signed && (word >> (width - 1)) != 0) {
+        word |= ~mask;
+      }
+    }
+    literal = {word};
+  }
+
+  const std::size_t end = function_section_begin(module);
+  for (std::size_t i = 0; i < end; ++i) {
+    const auto &inst = module.instructions[i];
+    if (inst.opcode() == OpConstant && inst.words[1] == type &&
+        std::equal(literal.begin(), literal.end(), inst.words.begin() + 3,
+                   inst.words.end())) {
+      return inst.words[2];
+    }
+  }
+  const uint32_t id = module.allocate_id();
+  Instruction constant;
+  constant.words = {0, type, id};
+  constant.words.insert(constant.words.end(), literal.begin(), literal.end());
+  constant.words[0] =
+      (static_cast<uint32_t>(constant.words.size()) << 16) | OpConstant;
+  module.instructions.insert(module.instructions.begin() +
+                                 static_cast<std::ptrdiff_t>(end),
+                             std::move(constant));
+  return id;
+}
+
+static bool is_annotation(Op opcode) {
+  switch (static_cast<uint32_t>(opcode)) {
+  case OpDecorate:
+  case OpMemberDecorate:
+  case OpDecorationGroup:
+  case 74: // OpGroupDecorate
+  case 75: // OpGroupMemberDecorate
+  case OpDecorateId:
+  case OpDecorateString:
+  case OpMemberDecorateString:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void add_annotation(Module &module, Instruction annotation) {
+  // Annotations follow the debug instructions and precede all declarations.
+  std::optional<std::size_t> last_annotation;
+  std::size_t first_declaration = module.instructions.size();
+  for (std::size_t i = 0; i < module.instructions.size(); ++i) {
+    const auto op = module.instructions[i].opcode();
+    if (is_annotation(op)) {
+      last_annotation = i;
+    } else if ((op >= OpTypeVoid && op <= OpSpecConstantOp) ||
+               op == OpVariable || op == OpFunction) {
+      first_declaration = std::min(first_declaration, i);
+    }
+  }
+  const std::size_t pos =
+      last_annotation.has_value() ? *last_annotation + 1 : first_declaration;
+  module.instructions.insert(module.instructions.begin() +
+                                 static_cast<std::ptrdiff_t>(pos),
+                             std::move(annotation));
+}
+
+std::optional<uint32_t> push_constant_variable(const Module &module) {
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() == OpVariable &&
+        inst.words[3] == StorageClassPushConstant) {
+      return inst.words[2];
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<PushConstantMember>
+append_push_constant_member(Module &module, uint32_t type, uint32_t offset) {
+  PushConstantMember member{};
+  uint32_t block;
+  if (auto variable = push_constant_variable(module)) {
+    member.variable = *variable;
+    const Instruction *var = find_definition(module, member.variable);
+    const Instruction *ptr = find_definition(module, var->words[1]);
+    block = ptr->words[3];
+    auto block_decl =
+        std::ranges::find_if(module.instructions, [&](const auto &inst) {
+          return inst.opcode() == OpTypeStruct && inst.words[1] == block;
+        });
+    if (block_decl == module.instructions.end()) {
+      return std::nullopt;
+    }
+    // A newly declared member type has to precede the block.
+    auto type_decl =
+        std::ranges::find_if(module.instructions, [&](const auto &inst) {
+          return result_id(inst) == type;
+        });
+    if (type_decl != module.instructions.end() && type_decl > block_decl) {
+      std::rotate(block_decl, type_decl, type_decl + 1);
+      ++block_decl;
+    }
+    member.member = static_cast<uint32_t>(block_decl->words.size() - 2);
+    block_decl->words.push_back(type);
+    block_decl->words[0] =
+        (static_cast<uint32_t>(block_decl->words.size()) << 16) | OpTypeStruct;
+  } else {
+    block = module.allocate_id();
+    member.member = 0;
+    member.declared_variable = true;
+    const std::size_t end = function_section_begin(module);
+    module.instructions.insert(module.instructions.begin() +
+                                   static_cast<std::ptrdiff_t>(end),
+                               make_instruction(OpTypeStruct, {block, type}));
+    add_annotation(module,
+                   make_instruction(OpDecorate, {block, DecorationBlock}));
+    const uint32_t pointer = find_or_add_type(
+        module, OpTypePointer, {StorageClassPushConstant, block});
+    member.variable = module.allocate_id();
+    module.instructions.insert(
+        module.instructions.begin() +
+            static_cast<std::ptrdiff_t>(function_section_begin(module)),
+        make_instruction(OpVariable, {pointer, member.variable,
+                                      StorageClassPushConstant}));
+  }
+  add_annotation(module, make_instruction(OpMemberDecorate,
+                                          {block, member.member,
+                                           DecorationOffset, offset}));
+  return member;
+}
+
+/// Default value and SpecId of a scalar (specialization) constant.
+static std::optional<std::pair<uint32_t, std::optional<uint32_t>>>
+scalar_constant(const Module &module, uint32_t id) {
+  const Instruction *inst = find_definition(module, id);
+  if (inst == nullptr || (inst->opcode() != OpConstant &&
+                          inst->opcode() != OpSpecConstant)) {
+    return std::nullopt;
+  }
+  std::optional<uint32_t> spec_id;
+  if (inst->opcode() == OpSpecConstant) {
+    for (const auto &dec : module.instructions) {
+      if (dec.opcode() == OpDecorate && dec.words[1] == id &&
+          dec.words[2] == DecorationSpecId) {
+        spec_id = dec.words[3];
+      }
+    }
+  }
+  return std::make_pair(inst->words[3], spec_id);
+}
+
+std::optional<LocalSize> reflect_local_size(const Module &module) {
+  const auto entries = entry_points(module);
+  auto entry = std::ranges::find_if(entries, [](const EntryPoint &e) {
+    return e.execution_model == ExecutionModelGLCompute && e.name == "main";
+  });
+  if (entry == entries.end()) {
+    entry = std::ranges::find_if(entries, [](const EntryPoint &e) {
+      return e.execution_model == ExecutionModelGLCompute;
+    });
+  }
+  if (entry == entries.end()) {
+    return std::nullopt;
+  }
+
+  std::optional<LocalSize> local_size;
+  std::optional<uint32_t> workgroup_size;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() == OpExecutionMode && inst.words[1] == entry->function &&
+        inst.words[2] == ExecutionModeLocalSize) {
+      local_size = LocalSize{
+          .size = {inst.words[3], inst.words[4], inst.words[5]},
+          .spec_ids = {},
+      };
+    } else if (inst.opcode() == OpExecutionModeId &&
+               inst.words[1] == entry->function &&
+               inst.words[2] == ExecutionModeLocalSizeId) {
+      LocalSize size{};
+      for (uint32_t d = 0; d < 3; ++d) {
+        auto constant = scalar_constant(module, inst.words[3 + d]);
+        if (!constant.has_value()) {
+          return std::nullopt;
+        }
+        size.size[d] = constant->first;
+        size.spec_ids[d] = constant->second;
+      }
+      local_size = size;
+    } else if (inst.opcode() == OpDecorate &&
+               inst.words[2] == DecorationBuiltIn &&
+               inst.words[3] == BuiltInWorkgroupSize) {
+      workgroup_size = inst.words[1];
+    }
+  }
+
+  // The WorkgroupSize builtin takes precedence over the execution mode.
+  if (workgroup_size.has_value()) {
+    const Instruction *composite = find_definition(module, *workgroup_size);
+    if (composite == nullptr || composite->words.size() != 6) {
+      return std::nullopt;
+    }
+    LocalSize size{};
+    for (uint32_t d = 0; d < 3; ++d) {
+      auto constant = scalar_constant(module, composite->words[3 + d]);
+      if (!constant.has_value()) {
+        return std::nullopt;
+      }
+      size.size[d] = constant->first;
+      size.spec_ids[d] = constant->second;
+    }
+    local_size = size;
+  }
+  return local_size;
+}
+
+} // namespace vkdt_denox::spirv
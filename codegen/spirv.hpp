@@ -0,0 +1,245 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+namespace vkdt_denox::spirv {
+
+static constexpr uint32_t MAGIC = 0x07230203;
+static constexpr std::size_t HEADER_WORDS = 5;
+
+// Subset of the SPIR-V opcodes, which the codegen passes have to understand.
+enum Op : uint16_t {
+  OpNop = 0,
+  OpSourceContinued = 2,
+  OpSource = 3,
+  OpSourceExtension = 4,
+  OpName = 5,
+  OpMemberName = 6,
+  OpString = 7,
+  OpLine = 8,
+  OpExtension = 10,
+  OpExtInstImport = 11,
+  OpExtInst = 12,
+  OpMemoryModel = 14,
+  OpEntryPoint = 15,
+  OpExecutionMode = 16,
+  OpCapability = 17,
+  OpTypeVoid = 19,
+  OpTypeBool = 20,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpTypeFunction = 33,
+  OpTypeForwardPointer = 39,
+  OpConstantTrue = 41,
+  OpConstantFalse = 42,
+  OpConstant = 43,
+  OpConstantComposite = 44,
+  OpConstantNull = 46,
+  OpSpecConstantTrue = 48,
+  OpSpecConstantFalse = 49,
+  OpSpecConstant = 50,
+  OpSpecConstantComposite = 51,
+  OpSpecConstantOp = 52,
+  OpFunction = 54,
+  OpFunctionParameter = 55,
+  OpFunctionEnd = 56,
+  OpFunctionCall = 57,
+  OpVariable = 59,
+  OpLoad = 61,
+  OpStore = 62,
+  OpAccessChain = 65,
+  OpInBoundsAccessChain = 66,
+  OpPtrAccessChain = 67,
+  OpDecorate = 71,
+  OpMemberDecorate = 72,
+  OpDecorationGroup = 73,
+  OpCompositeConstruct = 80,
+  OpCompositeExtract = 81,
+  OpCompositeInsert = 82,
+  OpCopyObject = 83,
+  OpIAdd = 128,
+  OpISub = 130,
+  OpIMul = 132,
+  OpUDiv = 134,
+  OpUMod = 137,
+  OpUGreaterThanEqual = 174,
+  OpPhi = 245,
+  OpLoopMerge = 246,
+  OpSelectionMerge = 247,
+  OpLabel = 248,
+  OpBranch = 249,
+  OpBranchConditional = 250,
+  OpReturn = 253,
+  OpNoLine = 317,
+  OpModuleProcessed = 330,
+  OpExecutionModeId = 331,
+  OpDecorateId = 332,
+  OpDecorateString = 5632,
+  OpMemberDecorateString = 5633,
+};
+
+enum Decoration : uint32_t {
+  DecorationSpecId = 1,
+  DecorationBlock = 2,
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationBuiltIn = 11,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35,
+};
+
+enum BuiltIn : uint32_t {
+  BuiltInNumWorkgroups = 24,
+  BuiltInWorkgroupSize = 25,
+  BuiltInWorkgroupId = 26,
+  BuiltInLocalInvocationId = 27,
+  BuiltInGlobalInvocationId = 28,
+};
+
+enum StorageClass : uint32_t {
+  StorageClassInput = 1,
+  StorageClassUniform = 2,
+  StorageClassPrivate = 6,
+  StorageClassPushConstant = 9,
+  StorageClassStorageBuffer = 12,
+};
+
+enum ExecutionModel : uint32_t {
+  ExecutionModelGLCompute = 5,
+};
+
+enum ExecutionMode : uint32_t {
+  ExecutionModeLocalSize = 17,
+  ExecutionModeLocalSizeId = 38,
+};
+
+struct Instruction {
+  // All words of the instruction, including the leading opcode word.
+  std::vector<uint32_t> words;
+
+  Op opcode() const { return static_cast<Op>(words[0] & 0xFFFF); }
+};
+
+struct Module {
+  std::array<uint32_t, HEADER_WORDS> header;
+  std::vector<Instruction> instructions;
+
+  uint32_t bound() const { return header[3]; }
+  uint32_t allocate_id() { return header[3]++; }
+};
+
+struct LocalSize {
+  std::array<uint32_t, 3> size;
+  // SpecIds of specialization constants, which control a dimension.
+  std::array<std::optional<uint32_t>, 3> spec_ids;
+};
+
+struct EntryPoint {
+  uint32_t execution_model;
+  uint32_t function;
+  std::string name;
+};
+
+Module parse(std::span<const uint32_t> spv);
+
+std::vector<uint32_t> assemble(const Module &module);
+
+Instruction make_instruction(Op opcode,
+                             std::initializer_list<uint32_t> operands);
+
+/// Decodes the nul terminated literal string starting at words[0].
+std::string read_string(std::span<const uint32_t> words);
+
+/// Number of words the literal string starting at words[0] occupies.
+std::size_t string_word_count(std::span<const uint32_t> words);
+
+void append_string(std::vector<uint32_t> &words, std::string_view str);
+
+/// Positions of the result type and result id within the instruction words.
+struct ResultLayout {
+  std::optional<uint32_t> type;
+  std::optional<uint32_t> result;
+};
+ResultLayout result_layout(Op opcode);
+
+std::optional<uint32_t> result_id(const Instruction &instruction);
+
+/// Positions of all ids within the instruction words, i.e. of the result
+/// type, the result id and the id operands. std::nullopt for instructions,
+/// whose operands are not known.
+std::optional<std::vector<uint32_t>> id_positions(const Module &module,
+                                                  const Instruction &inst);
+
+std::vector<EntryPoint> entry_points(const Module &module);
+
+/// Returns a module that only exposes the given compute entry point, renamed
+/// to "main". Other entry points and their execution modes are dropped.
+Module extract_entry_point(const Module &module, std::string_view name);
+
+/// Index of the first OpFunction, i.e. the end of the global section.
+std::size_t function_section_begin(const Module &module);
+
+/// Returns the instruction defining the id or nullptr (linear scan).
+const Instruction *find_definition(const Module &module, uint32_t id);
+
+/// Result id -> defining instruction, for passes with repeated lookups.
+/// Inserting instructions into the module invalidates the pointers.
+using Definitions = std::unordered_map<uint32_t, const Instruction *>;
+
+Definitions definitions(const Module &module);
+
+/// Returns the instruction defining the id or nullptr.
+const Instruction *find_definition(const Definitions &definitions,
+                                   uint32_t id);
+
+/// Value of an integer OpConstant, zero extended to 64 bits.
+std::optional<uint64_t> constant_value(const Module &module, uint32_t id);
+
+std::optional<uint64_t> constant_value(const Definitions &definitions,
+                                       uint32_t id);
+
+/// Finds a type declaration with the given operands (excluding the result
+/// id) or declares a new one at the end of the global section.
+uint32_t find_or_add_type(Module &module, Op opcode,
+                          std::initializer_list<uint32_t> operands);
+
+/// Finds or declares an integer OpConstant. Literals of types with at most
+/// 32 bits take one word, 64 bit literals two words (low word first).
+uint32_t find_or_add_constant(Module &module, uint32_t type, uint64_t value);
+
+/// Inserts a decoration at the end of the annotation section.
+void add_annotation(Module &module, Instruction annotation);
+
+/// Returns the OpVariable of the push constant block, if there is one.
+std::optional<uint32_t> push_constant_variable(const Module &module);
+
+struct PushConstantMember {
+  uint32_t variable;
+  uint32_t member;
+  // Whether the push constant block was declared by the call, the variable
+  // then has to be added to the entry point interface of SPIR-V >= 1.4.
+  bool declared_variable;
+};
+
+/// Appends a member of the type at the byte offset to the push constant
+/// block, which is declared if the module has none.
+std::optional<PushConstantMember>
+append_push_constant_member(Module &module, uint32_t type, uint32_t offset);
+
+/// Workgroup size of the compute entry point "main" (or the first compute
+/// entry point) from LocalSize, LocalSizeId or a WorkgroupSize builtin.
+std::optional<LocalSize> reflect_local_size(const Module &module);
+
+} // namespace vkdt_denox::spirv
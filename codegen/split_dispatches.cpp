@@ -0,0 +1,461 @@
+#include "split_dispatches.hpp"
+#include "spirv.hpp"
+#include "symbolics.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fmt/base.h>
+#include <map>
+#include <variant>
+
+namespace vkdt_denox {
+
+namespace {
+
+struct BuiltinVariables {
+  std::optional<uint32_t> workgroup_id;
+  std::optional<uint32_t> global_invocation_id;
+  std::optional<uint32_t> num_workgroups;
+  // Constant composite decorated as WorkgroupSize.
+  std::optional<uint32_t> workgroup_size;
+};
+
+} // namespace
+
+// Minimum maxPushConstantsSize guaranteed by Vulkan.
+static constexpr uint32_t max_push_constant_size = 128;
+
+static BuiltinVariables builtin_variables(const spirv::Module &module) {
+  BuiltinVariables builtins;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpDecorate ||
+        inst.words[2] != spirv::DecorationBuiltIn) {
+      continue;
+    }
+    switch (inst.words[3]) {
+    case spirv::BuiltInWorkgroupId:
+      builtins.workgroup_id = inst.words[1];
+      break;
+    case spirv::BuiltInGlobalInvocationId:
+      builtins.global_invocation_id = inst.words[1];
+      break;
+    case spirv::BuiltInNumWorkgroups:
+      builtins.num_workgroups = inst.words[1];
+      break;
+    case spirv::BuiltInWorkgroupSize:
+      builtins.workgroup_size = inst.words[1];
+      break;
+    default:
+      break;
+    }
+  }
+  return builtins;
+}
+
+/// The builtin can only be redirected to a private copy, if the functions
+/// exclusively load it or access its components.
+static bool only_loaded(const spirv::Module &module, uint32_t variable) {
+  const std::size_t begin = spirv::function_section_begin(module);
+  for (std::size_t i = begin; i < module.instructions.size(); ++i) {
+    const auto &inst = module.instructions[i];
+    const auto op = inst.opcode();
+    for (std::size_t w = 1; w < inst.words.size(); ++w) {
+      if (inst.words[w] != variable) {
+        continue;
+      }
+      const bool loaded = op == spirv::OpLoad && w == 3;
+      const bool accessed = (op == spirv::OpAccessChain ||
+                             op == spirv::OpInBoundsAccessChain) &&
+                            w == 3;
+      if (!loaded && !accessed) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Components of the workgroup size of the entry point, as constant ids.
+static std::optional<std::vector<uint32_t>>
+workgroup_size_constants(spirv::Module &module, uint32_t function,
+                         uint32_t uint_type) {
+  std::optional<std::array<uint32_t, 3>> literals;
+  std::optional<std::vector<uint32_t>> ids;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() == spirv::OpExecutionMode && inst.words[1] == function &&
+        inst.words[2] == spirv::ExecutionModeLocalSize) {
+      literals = {inst.words[3], inst.words[4], inst.words[5]};
+    } else if (inst.opcode() == spirv::OpExecutionModeId &&
+               inst.words[1] == function &&
+               inst.words[2] == spirv::ExecutionModeLocalSizeId) {
+      ids = std::vector<uint32_t>{inst.words[3], inst.words[4], inst.words[5]};
+    }
+  }
+  if (ids.has_value()) {
+    return ids;
+  }
+  if (!literals.has_value()) {
+    return std::nullopt;
+  }
+  std::vector<uint32_t> constants;
+  for (uint32_t size : *literals) {
+    constants.push_back(spirv::find_or_add_constant(module, uint_type, size));
+  }
+  return constants;
+}
+
+static void add_global(spirv::Module &module, spirv::Instruction inst) {
+  const std::size_t end = spirv::function_section_begin(module);
+  module.instructions.insert(module.instructions.begin() +
+                                 static_cast<std::ptrdiff_t>(end),
+                             std::move(inst));
+}
+
+/// Rewrites the entry point "main", such that a dispatch of
+/// (limit, y, z * ceil(x / limit)) workgroups behaves like a dispatch of
+/// (x, y, z) workgroups, where x is read from a push constant at pc_offset.
+static bool fold_workgroups(spirv::Module &module, uint32_t pc_offset,
+                            uint32_t limit) {
+  const auto entries = spirv::entry_points(module);
+  auto entry = std::ranges::find_if(entries, [](const auto &e) {
+    return e.execution_model == spirv::ExecutionModelGLCompute &&
+           e.name == "main";
+  });
+  if (entry == entries.end()) {
+    return false;
+  }
+  const uint32_t function = entry->function;
+
+  const BuiltinVariables builtins = builtin_variables(module);
+  if (builtins.num_workgroups.has_value()) {
+    return false;
+  }
+  if (!builtins.workgroup_id.has_value() &&
+      !builtins.global_invocation_id.has_value()) {
+    return false;
+  }
+  for (const auto &builtin :
+       {builtins.workgroup_id, builtins.global_invocation_id}) {
+    if (builtin.has_value() && !only_loaded(module, *builtin)) {
+      return false;
+    }
+  }
+
+  // === Declarations ===
+  const uint32_t uint_type = spirv::find_or_add_type(module, spirv::OpTypeInt,
+                                                     {32, 0});
+  const uint32_t uvec3_type =
+      spirv::find_or_add_type(module, spirv::OpTypeVector, {uint_type, 3});
+  const uint32_t bool_type =
+      spirv::find_or_add_type(module, spirv::OpTypeBool, {});
+
+  std::optional<std::vector<uint32_t>> workgroup_size;
+  if (builtins.global_invocation_id.has_value() &&
+      !builtins.workgroup_size.has_value()) {
+    workgroup_size = workgroup_size_constants(module, function, uint_type);
+    if (!workgroup_size.has_value()) {
+      return false;
+    }
+  }
+
+  const bool private_interface = module.header[1] >= 0x00010400;
+  std::vector<uint32_t> interface;
+
+  // Append the original x workgroup count to the push constant block.
+  const auto pc = spirv::append_push_constant_member(module, uint_type,
+                                                     pc_offset);
+  if (!pc.has_value()) {
+    return false;
+  }
+  const uint32_t pc_variable = pc->variable;
+  const uint32_t pc_member = pc->member;
+  if (pc->declared_variable && private_interface) {
+    interface.push_back(pc_variable);
+  }
+  const uint32_t pc_pointer = spirv::find_or_add_type(
+      module, spirv::OpTypePointer,
+      {spirv::StorageClassPushConstant, uint_type});
+
+  uint32_t workgroup_id;
+  if (builtins.workgroup_id.has_value()) {
+    workgroup_id = *builtins.workgroup_id;
+  } else {
+    const uint32_t pointer = spirv::find_or_add_type(
+        module, spirv::OpTypePointer, {spirv::StorageClassInput, uvec3_type});
+    workgroup_id = module.allocate_id();
+    add_global(module, spirv::make_instruction(
+                           spirv::OpVariable,
+                           {pointer, workgroup_id, spirv::StorageClassInput}));
+    spirv::add_annotation(
+        module, spirv::make_instruction(
+                    spirv::OpDecorate, {workgroup_id, spirv::DecorationBuiltIn,
+                                        spirv::BuiltInWorkgroupId}));
+    interface.push_back(workgroup_id);
+  }
+
+  // builtin variable -> private copy holding the unfolded value.
+  std::map<uint32_t, uint32_t> copies;
+  const uint32_t private_pointer = spirv::find_or_add_type(
+      module, spirv::OpTypePointer, {spirv::StorageClassPrivate, uvec3_type});
+  for (const auto &builtin :
+       {builtins.workgroup_id, builtins.global_invocation_id}) {
+    if (!builtin.has_value()) {
+      continue;
+    }
+    const uint32_t copy = module.allocate_id();
+    add_global(module,
+               spirv::make_instruction(spirv::OpVariable,
+                                       {private_pointer, copy,
+                                        spirv::StorageClassPrivate}));
+    copies.emplace(*builtin, copy);
+    if (private_interface) {
+      interface.push_back(copy);
+    }
+  }
+
+  // Access chains into the copies yield private pointers.
+  std::map<uint32_t, uint32_t> chain_types;
+  for (std::size_t i = spirv::function_section_begin(module);
+       i < module.instructions.size(); ++i) {
+    const auto &inst = module.instructions[i];
+    if ((inst.opcode() == spirv::OpAccessChain ||
+         inst.opcode() == spirv::OpInBoundsAccessChain) &&
+        copies.contains(inst.words[3])) {
+      chain_types.emplace(inst.words[1], 0);
+    }
+  }
+  // Declaring the private pointer types invalidates the index, therefore the
+  // pointees are looked up first.
+  const spirv::Definitions definitions = spirv::definitions(module);
+  std::map<uint32_t, uint32_t> pointees;
+  for (const auto &[input_type, _] : chain_types) {
+    pointees.emplace(input_type,
+                     spirv::find_definition(definitions, input_type)->words[3]);
+  }
+  for (auto &[input_type, private_type] : chain_types) {
+    private_type = spirv::find_or_add_type(
+        module, spirv::OpTypePointer,
+        {spirv::StorageClassPrivate, pointees.at(input_type)});
+  }
+
+  const uint32_t c_member = spirv::find_or_add_constant(module, uint_type,
+                                                        pc_member);
+  const uint32_t c_limit = spirv::find_or_add_constant(module, uint_type,
+                                                       limit);
+  const uint32_t c_limit_m1 =
+      spirv::find_or_add_constant(module, uint_type, limit - 1);
+
+  for (auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpEntryPoint || inst.words[2] != function) {
+      continue;
+    }
+    inst.words.insert(inst.words.end(), interface.begin(), interface.end());
+    inst.words[0] = (static_cast<uint32_t>(inst.words.size()) << 16) |
+                    spirv::OpEntryPoint;
+  }
+
+  // === Redirect the builtins to their copies ===
+  for (std::size_t i = spirv::function_section_begin(module);
+       i < module.instructions.size(); ++i) {
+    auto &inst = module.instructions[i];
+    const auto op = inst.opcode();
+    if (op != spirv::OpLoad && op != spirv::OpAccessChain &&
+        op != spirv::OpInBoundsAccessChain) {
+      continue;
+    }
+    auto it = copies.find(inst.words[3]);
+    if (it == copies.end()) {
+      continue;
+    }
+    inst.words[3] = it->second;
+    if (op != spirv::OpLoad) {
+      inst.words[1] = chain_types.at(inst.words[1]);
+    }
+  }
+
+  // === Prologue of the entry point ===
+  std::size_t label = spirv::function_section_begin(module);
+  while (module.instructions[label].opcode() != spirv::OpFunction ||
+         module.instructions[label].words[2] != function) {
+    ++label;
+  }
+  while (module.instructions[label].opcode() != spirv::OpLabel) {
+    ++label;
+  }
+  const uint32_t body = module.instructions[label].words[1];
+
+  std::vector<spirv::Instruction> prologue;
+  const uint32_t entry_label = module.allocate_id();
+  prologue.push_back(spirv::make_instruction(spirv::OpLabel, {entry_label}));
+  // Function variables have to stay in the first block.
+  for (std::size_t i = label + 1; i < module.instructions.size();) {
+    const auto op = module.instructions[i].opcode();
+    if (op == spirv::OpVariable) {
+      prologue.push_back(std::move(module.instructions[i]));
+      module.instructions.erase(module.instructions.begin() +
+                                static_cast<std::ptrdiff_t>(i));
+    } else if (op == spirv::OpLine || op == spirv::OpNoLine) {
+      ++i;
+    } else {
+      break;
+    }
+  }
+
+  auto emit = [&](spirv::Op op, uint32_t type,
+                  std::initializer_list<uint32_t> operands) {
+    const uint32_t id = module.allocate_id();
+    spirv::Instruction inst = spirv::make_instruction(op, {type, id});
+    inst.words.insert(inst.words.end(), operands.begin(), operands.end());
+    inst.words[0] = (static_cast<uint32_t>(inst.words.size()) << 16) | op;
+    prologue.push_back(std::move(inst));
+    return id;
+  };
+
+  const uint32_t wid = emit(spirv::OpLoad, uvec3_type, {workgroup_id});
+  const uint32_t wx =
+      emit(spirv::OpCompositeExtract, uint_type, {wid, 0});
+  const uint32_t wy =
+      emit(spirv::OpCompositeExtract, uint_type, {wid, 1});
+  const uint32_t wz =
+      emit(spirv::OpCompositeExtract, uint_type, {wid, 2});
+  const uint32_t count_ptr =
+      emit(spirv::OpAccessChain, pc_pointer, {pc_variable, c_member});
+  const uint32_t count = emit(spirv::OpLoad, uint_type, {count_ptr});
+  // Number of z slices, each x row was folded into.
+  const uint32_t count_up =
+      emit(spirv::OpIAdd, uint_type, {count, c_limit_m1});
+  const uint32_t slices = emit(spirv::OpUDiv, uint_type, {count_up, c_limit});
+  const uint32_t slice = emit(spirv::OpUMod, uint_type, {wz, slices});
+  const uint32_t x_offset = emit(spirv::OpIMul, uint_type, {slice, c_limit});
+  const uint32_t x = emit(spirv::OpIAdd, uint_type, {wx, x_offset});
+  const uint32_t z = emit(spirv::OpUDiv, uint_type, {wz, slices});
+  const uint32_t unfolded_wid =
+      emit(spirv::OpCompositeConstruct, uvec3_type, {x, wy, z});
+  if (builtins.workgroup_id.has_value()) {
+    prologue.push_back(spirv::make_instruction(
+        spirv::OpStore, {copies.at(workgroup_id), unfolded_wid}));
+  }
+  if (builtins.global_invocation_id.has_value()) {
+    uint32_t size;
+    if (builtins.workgroup_size.has_value()) {
+      size = *builtins.workgroup_size;
+    } else {
+      const auto &c = *workgroup_size;
+      size = emit(spirv::OpCompositeConstruct, uvec3_type, {c[0], c[1], c[2]});
+    }
+    const uint32_t gid =
+        emit(spirv::OpLoad, uvec3_type, {*builtins.global_invocation_id});
+    const uint32_t delta =
+        emit(spirv::OpISub, uvec3_type, {unfolded_wid, wid});
+    const uint32_t scaled = emit(spirv::OpIMul, uvec3_type, {delta, size});
+    const uint32_t unfolded_gid =
+        emit(spirv::OpIAdd, uvec3_type, {gid, scaled});
+    prologue.push_back(spirv::make_instruction(
+        spirv::OpStore,
+        {copies.at(*builtins.global_invocation_id), unfolded_gid}));
+  }
+
+  // Workgroups of the last slice beyond the original count return early.
+  const uint32_t surplus =
+      emit(spirv::OpUGreaterThanEqual, bool_type, {x, count});
+  const uint32_t exit_label = module.allocate_id();
+  prologue.push_back(
+      spirv::make_instruction(spirv::OpSelectionMerge, {body, 0}));
+  prologue.push_back(spirv::make_instruction(spirv::OpBranchConditional,
+                                             {surplus, exit_label, body}));
+  prologue.push_back(spirv::make_instruction(spirv::OpLabel, {exit_label}));
+  prologue.push_back(spirv::make_instruction(spirv::OpReturn, {}));
+
+  module.instructions.insert(module.instructions.begin() +
+                                 static_cast<std::ptrdiff_t>(label),
+                             std::make_move_iterator(prologue.begin()),
+                             std::make_move_iterator(prologue.end()));
+  return true;
+}
+
+} // namespace vkdt_denox
+
+vkdt_denox::DispatchSplitting vkdt_denox::split_oversized_dispatches(
+    ComputeGraph &compute_graph, ShaderRegistry &shader_registry,
+    uint32_t max_workgroup_count) {
+  DispatchSplitting result;
+
+  // binary id -> dispatch nodes, which may exceed the limit in x.
+  std::map<uint32_t, std::vector<uint32_t>> binaries;
+  for (uint32_t nid = 0; nid < compute_graph.nodes.size(); ++nid) {
+    const auto &node = compute_graph.nodes[nid];
+    if (!std::holds_alternative<ComputeDispatch>(node.op)) {
+      continue;
+    }
+    const auto &dispatch = std::get<ComputeDispatch>(node.op);
+    auto literal = [](const Symbol &symbol) -> std::optional<uint64_t> {
+      if (symbol.type != denox::dnx::ScalarSource_literal) {
+        return std::nullopt;
+      }
+      return read_unsigned_scalar_literal(
+          static_cast<const denox::dnx::ScalarLiteral *>(symbol.ptr));
+    };
+    for (const auto &[dim, count] :
+         {std::pair{'y', literal(dispatch.workgroup_count_y)},
+          std::pair{'z', literal(dispatch.workgroup_count_z)}}) {
+      if (count.has_value() && *count > max_workgroup_count) {
+        fmt::println(stderr,
+                     "Warning: dispatch {} launches {} workgroups in {}, "
+                     "which exceeds the limit of {}.",
+                     dispatch.name, *count, dim, max_workgroup_count);
+      }
+    }
+    const auto x = literal(dispatch.workgroup_count_x);
+    if (x.has_value() && *x <= max_workgroup_count) {
+      continue;
+    }
+    binaries[dispatch.binary_id].push_back(nid);
+  }
+
+  for (const auto &[binary_id, nodes] : binaries) {
+    uint16_t pc_size = 0;
+    for (uint32_t nid : nodes) {
+      const auto &dispatch =
+          std::get<ComputeDispatch>(compute_graph.nodes[nid].op);
+      pc_size = std::max(pc_size, dispatch.pc.size);
+    }
+    const auto pc_offset = static_cast<uint16_t>(align_up(pc_size, 4));
+
+    const auto &binary = shader_registry.binaries[binary_id];
+    if (pc_offset + sizeof(uint32_t) > max_push_constant_size) {
+      fmt::println(stderr,
+                   "Warning: kernel {} cannot be rewritten to split its "
+                   "dispatches, the workgroup count exceeds {} bytes of push "
+                   "constants.",
+                   binary.name, max_push_constant_size);
+      continue;
+    }
+    spirv::Module module = spirv::parse(binary.spv);
+    if (!fold_workgroups(module, pc_offset, max_workgroup_count)) {
+      fmt::println(stderr,
+                   "Warning: kernel {} cannot be rewritten to split its "
+                   "dispatches, workgroup counts beyond {} are not supported.",
+                   binary.name, max_workgroup_count);
+      continue;
+    }
+    const uint32_t id =
+        register_shader_binary(shader_registry, spirv::assemble(module));
+    result.rewritten_binaries += 1;
+
+    for (uint32_t nid : nodes) {
+      auto &dispatch = std::get<ComputeDispatch>(compute_graph.nodes[nid].op);
+      dispatch.binary_id = id;
+      dispatch.pc.fields.push_back(PushConstantField{
+          .offset = pc_offset,
+          .type = PushConstantType::U32,
+          .value = dispatch.workgroup_count_x,
+      });
+      dispatch.pc.size = static_cast<uint16_t>(pc_offset + sizeof(uint32_t));
+      dispatch.workgroup_limit = max_workgroup_count;
+      result.split_dispatches += 1;
+    }
+  }
+
+  prune_shader_registry(shader_registry, compute_graph);
+  return result;
+}
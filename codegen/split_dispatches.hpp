@@ -0,0 +1,22 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include "shader_registry.hpp"
+#include <cstdint>
+namespace vkdt_denox {
+
+struct DispatchSplitting {
+  uint32_t split_dispatches = 0;
+  uint32_t rewritten_binaries = 0;
+};
+
+/// Prepares dispatches, whose x workgroup count may exceed the per dimension
+/// limit, to be launched as a (limit, y, z * ceil(x / limit)) grid.
+/// The shaders are rewritten to recover the original WorkgroupId and
+/// GlobalInvocationId from the folded grid. The original x workgroup count
+/// is appended to the push constants and surplus workgroups return early.
+DispatchSplitting split_oversized_dispatches(ComputeGraph &compute_graph,
+                                             ShaderRegistry &shader_registry,
+                                             uint32_t max_workgroup_count);
+
+} // namespace vkdt_denox
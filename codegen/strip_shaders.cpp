@@ -0,0 +1,267 @@
+#include "strip_shaders.hpp"
+#include "spirv.hpp"
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+
+namespace vkdt_denox {
+
+static constexpr uint32_t DecorationUserSemantic = 5635;
+static constexpr uint32_t DecorationUserTypeGOOGLE = 5636;
+
+static bool is_debug_instruction(spirv::Op op) {
+  switch (op) {
+  case spirv::OpSourceContinued:
+  case spirv::OpSource:
+  case spirv::OpSourceExtension:
+  case spirv::OpName:
+  case spirv::OpMemberName:
+  case spirv::OpString:
+  case spirv::OpLine:
+  case spirv::OpNoLine:
+  case spirv::OpModuleProcessed:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Extended instruction sets, which only carry debug information.
+static bool is_debug_instruction_set(std::string_view name) {
+  return name.starts_with("NonSemantic.") || name == "OpenCL.DebugInfo.100" ||
+         name == "DebugInfo";
+}
+
+/// Removes debug instructions, debug and non-semantic extended instructions
+/// and reflection-only decorations.
+static void strip_debug_info(spirv::Module &module) {
+  std::unordered_set<uint32_t> debug_sets;
+  bool has_non_semantic_set = false;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() != spirv::OpExtInstImport) {
+      continue;
+    }
+    const std::string name =
+        spirv::read_string(std::span(inst.words).subspan(2));
+    if (is_debug_instruction_set(name)) {
+      debug_sets.insert(inst.words[1]);
+      has_non_semantic_set |= name.starts_with("NonSemantic.");
+    }
+  }
+
+  std::erase_if(module.instructions, [&](const spirv::Instruction &inst) {
+    const auto op = inst.opcode();
+    if (is_debug_instruction(op)) {
+      // Strings are removed below, once they are no longer referenced.
+      return op != spirv::OpString;
+    }
+    switch (op) {
+    case spirv::OpExtInstImport:
+      return debug_sets.contains(inst.words[1]);
+    case spirv::OpExtInst:
+      return debug_sets.contains(inst.words[3]);
+    case spirv::OpExtension:
+      return has_non_semantic_set &&
+             spirv::read_string(std::span(inst.words).subspan(1)) ==
+                 "SPV_KHR_non_semantic_info";
+    case spirv::OpDecorateString:
+      return inst.words[2] == DecorationUserSemantic ||
+             inst.words[2] == DecorationUserTypeGOOGLE;
+    case spirv::OpMemberDecorateString:
+      return inst.words[3] == DecorationUserSemantic ||
+             inst.words[3] == DecorationUserTypeGOOGLE;
+    default:
+      return false;
+    }
+  });
+
+  // Instructions of other extended instruction sets may still refer to
+  // strings. Operands of unknown instructions are not classified, therefore
+  // any of their words counts as a reference.
+  std::unordered_set<uint32_t> referenced;
+  for (const auto &inst : module.instructions) {
+    if (inst.opcode() == spirv::OpString) {
+      continue;
+    }
+    if (auto positions = spirv::id_positions(module, inst)) {
+      for (uint32_t w : *positions) {
+        referenced.insert(inst.words[w]);
+      }
+    } else {
+      referenced.insert(inst.words.begin() + 1, inst.words.end());
+    }
+  }
+  std::erase_if(module.instructions, [&](const spirv::Instruction &inst) {
+    return inst.opcode() == spirv::OpString &&
+           !referenced.contains(inst.words[1]);
+  });
+}
+
+static bool is_removable_global(spirv::Op op) {
+  switch (op) {
+  case spirv::OpTypeVoid:
+  case spirv::OpTypeBool:
+  case spirv::OpTypeInt:
+  case spirv::OpTypeFloat:
+  case spirv::OpTypeVector:
+  case spirv::OpTypeArray:
+  case spirv::OpTypeRuntimeArray:
+  case spirv::OpTypeStruct:
+  case spirv::OpTypePointer:
+  case spirv::OpTypeFunction:
+  case spirv::OpConstantTrue:
+  case spirv::OpConstantFalse:
+  case spirv::OpConstant:
+  case spirv::OpConstantComposite:
+  case spirv::OpConstantNull:
+    return true;
+  default:
+    // Specialization constants are part of the pipeline interface.
+    return false;
+  }
+}
+
+/// Decorations, which do not keep their target alive.
+static bool is_weak_decoration(const spirv::Instruction &inst) {
+  switch (inst.opcode()) {
+  case spirv::OpDecorate:
+  case spirv::OpDecorateId:
+    return inst.words[2] != spirv::DecorationBuiltIn &&
+           inst.words[2] != spirv::DecorationSpecId;
+  case spirv::OpMemberDecorate:
+    return inst.words[3] != spirv::DecorationBuiltIn;
+  case spirv::OpDecorateString:
+  case spirv::OpMemberDecorateString:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Removes types and constants, which are never referenced. Operands are not
+/// classified, therefore any word equal to an id counts as a reference and
+/// the pass errs on the side of keeping declarations.
+static void remove_unused_globals(spirv::Module &module) {
+  const bool has_forward_pointers =
+      std::ranges::any_of(module.instructions, [](const auto &inst) {
+        return inst.opcode() == spirv::OpTypeForwardPointer;
+      });
+  if (has_forward_pointers) {
+    return;
+  }
+
+  while (true) {
+    std::unordered_map<uint32_t, uint32_t> uses;
+    for (const auto &inst : module.instructions) {
+      const auto layout = spirv::result_layout(inst.opcode());
+      const std::size_t first = is_weak_decoration(inst) ? 2 : 1;
+      for (std::size_t w = first; w < inst.words.size(); ++w) {
+        if (layout.result == w) {
+          continue;
+        }
+        ++uses[inst.words[w]];
+      }
+    }
+
+    std::unordered_set<uint32_t> unused;
+    for (const auto &inst : module.instructions) {
+      if (!is_removable_global(inst.opcode())) {
+        continue;
+      }
+      const uint32_t id = *spirv::result_id(inst);
+      if (!uses.contains(id)) {
+        unused.insert(id);
+      }
+    }
+    if (unused.empty()) {
+      break;
+    }
+    std::erase_if(module.instructions, [&](const spirv::Instruction &inst) {
+      if (is_weak_decoration(inst)) {
+        return unused.contains(inst.words[1]);
+      }
+      return is_removable_global(inst.opcode()) &&
+             unused.contains(*spirv::result_id(inst));
+    });
+  }
+}
+
+/// Renumbers the ids densely in the order of their definitions, such that the
+/// bound is as small as possible. Modules with instructions, whose operands
+/// are not known, keep their ids and only get the bound lowered.
+static void compact_ids(spirv::Module &module) {
+  std::vector<std::vector<uint32_t>> positions;
+  positions.reserve(module.instructions.size());
+  std::unordered_map<uint32_t, uint32_t> ids;
+  uint32_t next_id = 1;
+  for (const auto &inst : module.instructions) {
+    if (auto id = spirv::result_id(inst)) {
+      ids.emplace(*id, next_id++);
+    }
+  }
+  bool known = true;
+  for (const auto &inst : module.instructions) {
+    auto inst_positions = spirv::id_positions(module, inst);
+    known = inst_positions.has_value() &&
+            std::ranges::all_of(*inst_positions, [&](uint32_t w) {
+              return ids.contains(inst.words[w]);
+            });
+    if (!known) {
+      break;
+    }
+    positions.push_back(std::move(*inst_positions));
+  }
+
+  if (!known) {
+    uint32_t max_id = 0;
+    for (const auto &inst : module.instructions) {
+      if (auto id = spirv::result_id(inst)) {
+        max_id = std::max(max_id, *id);
+      }
+    }
+    module.header[3] = max_id + 1;
+    return;
+  }
+  for (std::size_t i = 0; i < module.instructions.size(); ++i) {
+    auto &words = module.instructions[i].words;
+    for (uint32_t w : positions[i]) {
+      words[w] = ids.at(words[w]);
+    }
+  }
+  module.header[3] = next_id;
+}
+
+} // namespace vkdt_denox
+
+std::vector<vkdt_denox::StrippedShader>
+vkdt_denox::strip_shader_binaries(ComputeGraph &compute_graph,
+                                  ShaderRegistry &registry) {
+  std::vector<StrippedShader> stripped;
+  const uint32_t binary_count = registry.binaries.size();
+  std::vector<uint32_t> remap(binary_count);
+  for (uint32_t i = 0; i < binary_count; ++i) {
+    spirv::Module module = spirv::parse(registry.binaries[i].spv);
+    strip_debug_info(module);
+    remove_unused_globals(module);
+    compact_ids(module);
+
+    const std::size_t bytes_before = registry.binaries[i].spv.size_bytes();
+    remap[i] = register_shader_binary(registry, spirv::assemble(module));
+    stripped.push_back(StrippedShader{
+        .name = registry.binaries[remap[i]].name,
+        .bytes_before = bytes_before,
+        .bytes_after = registry.binaries[remap[i]].spv.size_bytes(),
+    });
+  }
+
+  for (auto &node : compute_graph.nodes) {
+    if (std::holds_alternative<ComputeDispatch>(node.op)) {
+      auto &dispatch = std::get<ComputeDispatch>(node.op);
+      dispatch.binary_id = remap[dispatch.binary_id];
+    }
+  }
+  prune_shader_registry(registry, compute_graph);
+  return stripped;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "compute_graph.hpp"
+#include "shader_registry.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+namespace vkdt_denox {
+
+struct StrippedShader {
+  std::string name;
+  std::size_t bytes_before;
+  std::size_t bytes_after;
+};
+
+/// Removes debug, non-semantic and reflection-only instructions as well as
+/// unused types and constants from all binaries of the registry and
+/// renumbers their ids densely.
+std::vector<StrippedShader> strip_shader_binaries(ComputeGraph &compute_graph,
+                                                  ShaderRegistry &registry);
+
+} // namespace vkdt_denox
@@ -0,0 +1,135 @@
+#include "symbolic_codegen.hpp"
+#include <cassert>
+#include <dnx.h>
+#include <fmt/format.h>
+#include <stdexcept>
+
+std::string vkdt_denox::access_symbol(const SymbolicIR &ir, Symbol symbol,
+                                      std::vector<bool> &referenced_symbols,
+                                      std::string_view suffix) {
+  if (symbol.type == denox::dnx::ScalarSource_symbolic) {
+    const auto *sym_ref = static_cast<const denox::dnx::SymRef *>(symbol.ptr);
+    const uint32_t sid = sym_ref->sid();
+    referenced_symbols[sid] = true;
+    if (sid < ir.vars.size()) {
+      return fmt::format("{}{}", ir.vars[sid], suffix);
+    } else {
+      return fmt::format("r{}{}", sym_ref->sid(), suffix);
+    }
+  } else if (symbol.type == denox::dnx::ScalarSource_literal) {
+    return fmt::format(
+        "{}", vkdt_denox::read_unsigned_scalar_literal(
+                  static_cast<const denox::dnx::ScalarLiteral *>(symbol.ptr)));
+  } else {
+    throw std::runtime_error("invalid scalar source type!");
+  }
+}
+
+void vkdt_denox::eval_symbolics(SourceWriter &src, const SymbolicIR &ir,
+                                const std::vector<bool> &referenced_symbols,
+                                std::string_view suffix) {
+
+  const uint32_t m = ir.symir->ops()->size();
+  const uint32_t k = ir.vars.size();
+  const uint32_t n = k + m;
+
+  std::vector<std::string> symbol_names(n);
+  for (size_t i = 0; i < k; ++i) {
+    symbol_names[i] = fmt::format("{}{}", ir.vars[i], suffix);
+  }
+
+  std::vector<uint32_t> ref_counts(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    ref_counts[i] = referenced_symbols[i] ? 1 : 0;
+  }
+
+  std::vector<std::string> expressions(m);
+  for (uint32_t i = 0; i < m; ++i) {
+    uint32_t sid = k + i;
+    const auto *op = ir.symir->ops()->Get(i);
+    const auto opcode = op->opcode();
+
+    std::string lhs;
+    if (opcode & denox::dnx::SymIROpCode_LHSC) {
+      lhs = fmt::format("{}", op->lhs());
+    } else {
+      uint32_t sid = op->lhs();
+      lhs = symbol_names[sid];
+      ++ref_counts[op->lhs()];
+    }
+
+    std::string rhs;
+    if (opcode & denox::dnx::SymIROpCode_RHSC) {
+      rhs = fmt::format("{}", op->rhs());
+    } else {
+      uint32_t sid = op->rhs();
+      rhs = symbol_names[sid];
+      ++ref_counts[op->rhs()];
+    }
+
+    auto mask = ~denox::dnx::SymIROpCode_LHSC & ~denox::dnx::SymIROpCode_RHSC;
+
+    auto operation = opcode & mask;
+
+    std::string expr;
+    if (operation == denox::dnx::SymIROpCode_ADD) {
+      expr = fmt::format("{} + {}", lhs, rhs);
+    } else if (operation == denox::dnx::SymIROpCode_SUB) {
+      expr = fmt::format("{} - {}", lhs, rhs);
+    } else if (operation == denox::dnx::SymIROpCode_MUL) {
+      expr = fmt::format("{} * {}", lhs, rhs);
+    } else if (operation == denox::dnx::SymIROpCode_DIV) {
+      expr = fmt::format("{} / {}", lhs, rhs);
+    } else if (operation == denox::dnx::SymIROpCode_MOD) {
+      expr = fmt::format("(({} % {}) + {}) % {}", lhs, rhs, rhs, rhs);
+    } else if (operation == denox::dnx::SymIROpCode_MIN) {
+      expr = fmt::format("{} < {} ? {} : {}", lhs, rhs, lhs, rhs);
+    } else if (operation == denox::dnx::SymIROpCode_MAX) {
+      expr = fmt::format("{} < {} ? {} : {}", lhs, rhs, rhs, lhs);
+    }
+
+    std::string symbol_name = fmt::format("r{}{}", sid, suffix);
+    symbol_names[sid] = symbol_name;
+    expressions[i] = fmt::format("const int64_t {} = {};", symbol_name, expr);
+  }
+
+  std::vector<bool> pruned_expressions(m, false);
+
+  while (true) {
+    bool pruned_once = false;
+
+    for (uint32_t i = 0; i < m; ++i) {
+      uint32_t sid = i + k;
+      if (pruned_expressions[i]) {
+        continue;
+      }
+      if (ref_counts[sid] > 0) {
+        continue;
+      }
+      pruned_expressions[i] = true;
+      pruned_once = true;
+      const auto *op = ir.symir->ops()->Get(i);
+      if (!(op->opcode() & denox::dnx::SymIROpCode_LHSC)) {
+        uint32_t sid = op->lhs();
+        assert(ref_counts[sid] > 0);
+        --ref_counts[sid];
+      }
+
+      if (!(op->opcode() & denox::dnx::SymIROpCode_RHSC)) {
+        uint32_t sid = op->rhs();
+        assert(ref_counts[sid] > 0);
+        --ref_counts[sid];
+      }
+    }
+
+    if (!pruned_once) {
+      break;
+    }
+  }
+
+  for (uint32_t i = 0; i < m; ++i) {
+    if (ref_counts[k + i] > 0) {
+      src.append(expressions[i]);
+    }
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "source_writer.hpp"
+#include "symbolics.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+namespace vkdt_denox {
+
+/// C expression of the symbol, marks the symbol as referenced.
+/// The suffix is appended to all names, which allows to evaluate the IR for
+/// several sets of variables within the same scope.
+std::string access_symbol(const SymbolicIR &ir, Symbol symbol,
+                          std::vector<bool> &referenced_symbols,
+                          std::string_view suffix = {});
+
+/// Emits the C definitions of all referenced symbols (and their operands).
+void eval_symbolics(SourceWriter &src, const SymbolicIR &ir,
+                    const std::vector<bool> &referenced_symbols,
+                    std::string_view suffix = {});
+
+} // namespace vkdt_denox
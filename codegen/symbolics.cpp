@@ -1,4 +1,5 @@
 #include "symbolics.hpp"
+#include <cstring>
 #include <dnx.h>
 #include <fmt/format.h>
 #include <stdexcept>
@@ -89,3 +90,66 @@ uint64_t vkdt_denox::read_unsigned_scalar_literal(
   }
   return v;
 }
+
+std::vector<int64_t>
+vkdt_denox::evaluate_symbolic_ir(const SymbolicIR &ir,
+                                 std::span<const int64_t> vars) {
+  const uint32_t k = ir.vars.size();
+  const uint32_t m = ir.symir->ops()->size();
+  if (vars.size() != k) {
+    throw std::runtime_error(fmt::format(
+        "expected values for {} symbolic variables, got {}.", k, vars.size()));
+  }
+  std::vector<int64_t> values(vars.begin(), vars.end());
+  values.reserve(k + m);
+
+  const auto mask =
+      ~denox::dnx::SymIROpCode_LHSC & ~denox::dnx::SymIROpCode_RHSC;
+  for (uint32_t i = 0; i < m; ++i) {
+    const auto *op = ir.symir->ops()->Get(i);
+    const auto opcode = op->opcode();
+    const int64_t lhs = (opcode & denox::dnx::SymIROpCode_LHSC)
+                            ? op->lhs()
+                            : values[static_cast<uint32_t>(op->lhs())];
+    const int64_t rhs = (opcode & denox::dnx::SymIROpCode_RHSC)
+                            ? op->rhs()
+                            : values[static_cast<uint32_t>(op->rhs())];
+    const auto operation = opcode & mask;
+    if ((operation == denox::dnx::SymIROpCode_DIV ||
+         operation == denox::dnx::SymIROpCode_MOD) &&
+        rhs == 0) {
+      throw std::runtime_error(
+          fmt::format("division by zero while evaluating symbol r{}.", k + i));
+    }
+    int64_t value = 0;
+    if (operation == denox::dnx::SymIROpCode_ADD) {
+      value = lhs + rhs;
+    } else if (operation == denox::dnx::SymIROpCode_SUB) {
+      value = lhs - rhs;
+    } else if (operation == denox::dnx::SymIROpCode_MUL) {
+      value = lhs * rhs;
+    } else if (operation == denox::dnx::SymIROpCode_DIV) {
+      value = lhs / rhs;
+    } else if (operation == denox::dnx::SymIROpCode_MOD) {
+      value = ((lhs % rhs) + rhs) % rhs;
+    } else if (operation == denox::dnx::SymIROpCode_MIN) {
+      value = lhs < rhs ? lhs : rhs;
+    } else if (operation == denox::dnx::SymIROpCode_MAX) {
+      value = lhs < rhs ? rhs : lhs;
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+int64_t vkdt_denox::evaluate_symbol(std::span<const int64_t> values,
+                                    Symbol symbol) {
+  if (symbol.type == denox::dnx::ScalarSource_symbolic) {
+    const auto *sym_ref = static_cast<const denox::dnx::SymRef *>(symbol.ptr);
+    return values[sym_ref->sid()];
+  } else if (symbol.type == denox::dnx::ScalarSource_literal) {
+    return static_cast<int64_t>(read_unsigned_scalar_literal(
+        static_cast<const denox::dnx::ScalarLiteral *>(symbol.ptr)));
+  }
+  throw std::runtime_error("invalid scalar source type!");
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "dnx.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace vkdt_denox {
 
@@ -19,4 +23,12 @@ SymbolicIR read_symbolic_ir(const denox::dnx::Model *dnx);
 
 uint64_t read_unsigned_scalar_literal(const denox::dnx::ScalarLiteral *literal);
 
+/// Evaluates all symbols for the given values of the variables, with the
+/// semantics of the generated C code. The first values are the variables.
+std::vector<int64_t> evaluate_symbolic_ir(const SymbolicIR &ir,
+                                          std::span<const int64_t> vars);
+
+/// Value of a symbol, given the values of evaluate_symbolic_ir.
+int64_t evaluate_symbol(std::span<const int64_t> values, Symbol symbol);
+
 } // namespace vkdt_denox
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+namespace vkdt_denox {
+
+/// Waits for all futures, when it goes out of scope. Tasks, which reference
+/// locals of the submitting function, then finish before an exception (e.g.
+/// of a sibling task or of the submitting function itself) unwinds them.
+template <typename T> class FutureGuard {
+public:
+  explicit FutureGuard(std::vector<std::future<T>> &futures)
+      : m_futures(futures) {}
+
+  FutureGuard(const FutureGuard &) = delete;
+  FutureGuard &operator=(const FutureGuard &) = delete;
+
+  ~FutureGuard() {
+    for (auto &future : m_futures) {
+      if (future.valid()) {
+        future.wait();
+      }
+    }
+  }
+
+private:
+  std::vector<std::future<T>> &m_futures;
+};
+
+/// Minimal task scheduler for the independent stages of the codegen.
+///
+/// With a single job every task runs inline on the submitting thread, such
+/// that the sequential mode does not spawn any threads. Tasks must not wait
+/// for other tasks of the same pool.
+class TaskPool {
+public:
+  explicit TaskPool(std::size_t jobs) : m_jobs(jobs == 0 ? 1 : jobs) {
+    if (m_jobs == 1) {
+      return;
+    }
+    m_workers.reserve(m_jobs);
+    for (std::size_t i = 0; i < m_jobs; ++i) {
+      m_workers.emplace_back([this] { work(); });
+    }
+  }
+
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+
+  ~TaskPool() {
+    {
+      std::lock_guard lock{m_mutex};
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  /// Exceptions of the task are rethrown by the returned future.
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F &&task) {
+    using R = std::invoke_result_t<F>;
+    auto packaged =
+        std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+    std::future<R> future = packaged->get_future();
+    if (m_workers.empty()) {
+      (*packaged)();
+      return future;
+    }
+    {
+      std::lock_guard lock{m_mutex};
+      m_tasks.emplace_back([packaged] { (*packaged)(); });
+    }
+    m_cv.notify_one();
+    return future;
+  }
+
+  /// Calls fn(i) for every i in [0, count), split into one chunk per job,
+  /// and waits for all of them.
+  template <typename F> void parallel_for(std::size_t count, F &&fn) {
+    const std::size_t chunk = (count + m_jobs - 1) / m_jobs;
+    std::vector<std::future<void>> futures;
+    FutureGuard guard(futures);
+    for (std::size_t begin = 0; begin < count; begin += chunk) {
+      const std::size_t end = std::min(begin + chunk, count);
+      futures.push_back(submit([&fn, begin, end] {
+        for (std::size_t i = begin; i < end; ++i) {
+          fn(i);
+        }
+      }));
+    }
+    for (auto &future : futures) {
+      future.get();
+    }
+  }
+
+  std::size_t jobs() const { return m_jobs; }
+
+private:
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock{m_mutex};
+        m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+        if (m_tasks.empty()) {
+          return;
+        }
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::size_t m_jobs;
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop = false;
+};
+
+} // namespace vkdt_denox
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 namespace vkdt_denox {
 
 inline std::size_t align_up(std::size_t offset,
@@ -11,4 +12,16 @@ inline std::size_t align_up(std::size_t offset,
   return (offset + alignment - 1) & ~(alignment - 1);
 }
 
+// 64-bit FNV-1a, used to content address shaders and weights.
+inline std::uint64_t
+fnv1a64(const void *data, std::size_t size,
+        std::uint64_t hash = 0xcbf29ce484222325ull) noexcept {
+  const auto *bytes = static_cast<const std::uint8_t *>(data);
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
 } // namespace vkdt_denox